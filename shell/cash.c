@@ -1,61 +1,496 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <termios.h>
 #include <unistd.h>
 
 #include "command.h"
 
+// posix_spawn can hand the terminal to the child since glibc 2.35
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 35)
+#define HAVE_SPAWN_TCSETPGRP 1
+#endif
+#endif
+
 extern char **environ;
 bool shell_is_interactive = true;
 
-// Simple linked list to track background job PIDs
-typedef struct bg_job {
+// Job table. Every pipeline is a job, kept here while any of its stages is
+// running or stopped. Jobs are indexed by job number, for %n in fg and bg,
+// and each stage by its pid, so that a status change is applied in O(1).
+// The SIGCHLD handler reaps children as soon as they change state and
+// queues their statuses; the shell applies the queue to the table whenever
+// it next looks at it, with SIGCHLD blocked.
+
+typedef enum { STAGE_RUNNING, STAGE_STOPPED, STAGE_EXITED } stage_state_t;
+
+typedef struct job_stage {
+    pid_t pid;
+    stage_state_t state;
+    int status; // Wait status, once exited
+} job_stage_t;
+
+typedef struct job {
+    int id;
+    pid_t pgid;
+    char *command;
+    bool background;
+    bool has_tmodes; // Whether tmodes holds the terminal modes it stopped in
+    struct termios tmodes;
+    job_stage_t *stages;
+    size_t num_stages;
+    size_t num_running; // Stages neither stopped nor exited
+    size_t num_exited;
+} job_t;
+
+// Jobs by number; slot 0 is unused and a new job gets max_job_id + 1
+static job_t **jobs_by_id = NULL;
+static size_t jobs_capacity = 0;
+static int max_job_id = 0;
+
+// Background jobs with a stage running
+static size_t num_bg_running = 0;
+
+// Most background jobs to run at once, set by jobs -j or CASH_MAX_JOBS; a
+// launch beyond it waits for one to finish. 0 means no limit.
+static size_t max_bg_jobs = 0;
+
+// Open addressing table from the pid of every unexited stage to its job
+typedef struct pid_slot {
+    pid_t pid; // 0 if free
+    job_t *job;
+    size_t stage;
+} pid_slot_t;
+
+static pid_slot_t *pid_slots = NULL;
+static size_t pid_capacity = 0; // A power of two
+static size_t pid_count = 0;
+
+// Statuses reaped by the SIGCHLD handler and not yet applied to the table.
+// The handler only appends, and the shell only removes with SIGCHLD blocked.
+#define CHILD_EVENTS 1024
+
+static struct {
     pid_t pid;
-    struct bg_job *next;
-} bg_job_t;
+    int status;
+} child_events[CHILD_EVENTS];
+static volatile unsigned child_events_head = 0;
+static volatile unsigned child_events_tail = 0;
+
+// Terminal modes of the shell, restored when a foreground job stops
+static struct termios shell_tmodes;
 
-bg_job_t *bg_jobs = NULL;
+// Signal mask for children, which must not inherit a blocked SIGCHLD
+static sigset_t child_sigmask;
 
-// Add a background job to the list
-static void add_bg_job(pid_t pid) {
-    bg_job_t *job = malloc(sizeof(bg_job_t));
-    if (job == NULL) {
+static size_t pid_slot_index(pid_t pid) {
+    return ((size_t) pid * 2654435761u) & (pid_capacity - 1);
+}
+
+static pid_slot_t *pid_find(pid_t pid) {
+    if (pid_capacity == 0) {
+        return NULL;
+    }
+    for (size_t i = pid_slot_index(pid);; i = (i + 1) & (pid_capacity - 1)) {
+        if (pid_slots[i].pid == pid) {
+            return &pid_slots[i];
+        } else if (pid_slots[i].pid == 0) {
+            return NULL;
+        }
+    }
+}
+
+static void pid_insert_slot(pid_slot_t slot) {
+    size_t i = pid_slot_index(slot.pid);
+    while (pid_slots[i].pid != 0) {
+        i = (i + 1) & (pid_capacity - 1);
+    }
+    pid_slots[i] = slot;
+}
+
+// Map pid to stage of job. Returns false if out of memory.
+static bool pid_insert(pid_t pid, job_t *job, size_t stage) {
+    // Keep the table at most half full
+    if (2 * (pid_count + 1) > pid_capacity) {
+        size_t old_capacity = pid_capacity;
+        pid_slot_t *old_slots = pid_slots;
+        size_t capacity = old_capacity == 0 ? 64 : 2 * old_capacity;
+        pid_slot_t *slots = calloc(capacity, sizeof(pid_slot_t));
+        if (slots == NULL) {
+            return false;
+        }
+        pid_slots = slots;
+        pid_capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i].pid != 0) {
+                pid_insert_slot(old_slots[i]);
+            }
+        }
+        free(old_slots);
+    }
+    pid_insert_slot((pid_slot_t){pid, job, stage});
+    pid_count++;
+    return true;
+}
+
+// Remove the slot of a pid, moving later slots of its run back into the gap
+// so that lookups never need tombstones
+static void pid_remove(pid_slot_t *slot) {
+    size_t mask = pid_capacity - 1;
+    size_t gap = slot - pid_slots;
+    for (size_t i = (gap + 1) & mask; pid_slots[i].pid != 0;
+         i = (i + 1) & mask) {
+        size_t home = pid_slot_index(pid_slots[i].pid);
+        // Move the entry if its home is not cyclically in (gap, i]
+        if (((i - home) & mask) >= ((i - gap) & mask)) {
+            pid_slots[gap] = pid_slots[i];
+            gap = i;
+        }
+    }
+    pid_slots[gap].pid = 0;
+    pid_count--;
+}
+
+static bool job_is_done(const job_t *job) {
+    return job->num_exited == job->num_stages;
+}
+
+static bool job_is_stopped(const job_t *job) {
+    return job->num_running == 0 && !job_is_done(job);
+}
+
+static bool job_counts_as_bg_running(const job_t *job) {
+    return job->background && job->num_running > 0;
+}
+
+// Keep num_bg_running in step with a change to job; was is the value of
+// job_counts_as_bg_running from before the change
+static void job_changed(const job_t *job, bool was) {
+    num_bg_running += job_counts_as_bg_running(job);
+    num_bg_running -= was;
+}
+
+// Add a job of the given pids (0 for a stage that did not start) to the
+// table. Returns NULL if out of memory.
+static job_t *add_job(const pid_t *pids, size_t num_pids, pid_t pgid,
+                      const char *command) {
+    if ((size_t) max_job_id + 1 >= jobs_capacity) {
+        size_t capacity = jobs_capacity == 0 ? 16 : 2 * jobs_capacity;
+        job_t **jobs = realloc(jobs_by_id, capacity * sizeof(job_t *));
+        if (jobs == NULL) {
+            perror("malloc");
+            return NULL;
+        }
+        memset(jobs + jobs_capacity, 0,
+               (capacity - jobs_capacity) * sizeof(job_t *));
+        jobs_by_id = jobs;
+        jobs_capacity = capacity;
+    }
+
+    job_t *job = calloc(1, sizeof(job_t));
+    if (job != NULL) {
+        job->stages = calloc(num_pids, sizeof(job_stage_t));
+        job->command = strdup(command);
+    }
+    if (job == NULL || job->stages == NULL || job->command == NULL) {
         perror("malloc");
-        return;
+        if (job != NULL) {
+            free(job->stages);
+            free(job->command);
+            free(job);
+        }
+        return NULL;
+    }
+
+    job->pgid = pgid;
+    for (size_t i = 0; i < num_pids; i++) {
+        if (pids[i] <= 0) {
+            continue;
+        }
+        size_t k = job->num_stages++;
+        job->stages[k].pid = pids[i];
+        job->stages[k].state = STAGE_RUNNING;
+        job->num_running++;
+        if (!pid_insert(pids[i], job, k)) {
+            perror("malloc");
+        }
     }
-    job->pid = pid;
-    job->next = bg_jobs;
-    bg_jobs = job;
+
+    job->id = ++max_job_id;
+    jobs_by_id[job->id] = job;
+    return job;
 }
 
-// Wait for all background jobs to complete
-static void wait_all_bg_jobs(void) {
-    while (bg_jobs != NULL) {
+// Remove a job from the table and free it
+static void remove_job(job_t *job) {
+    num_bg_running -= job_counts_as_bg_running(job);
+    for (size_t i = 0; i < job->num_stages; i++) {
+        if (job->stages[i].state != STAGE_EXITED) {
+            pid_slot_t *slot = pid_find(job->stages[i].pid);
+            if (slot != NULL) {
+                pid_remove(slot);
+            }
+        }
+    }
+    jobs_by_id[job->id] = NULL;
+    while (max_job_id > 0 && jobs_by_id[max_job_id] == NULL) {
+        max_job_id--;
+    }
+    free(job->stages);
+    free(job->command);
+    free(job);
+}
+
+// The job fg and bg act on by default: the newest stopped job, or else the
+// newest job
+static job_t *current_job(void) {
+    for (int id = max_job_id; id > 0; id--) {
+        if (jobs_by_id[id] != NULL && job_is_stopped(jobs_by_id[id])) {
+            return jobs_by_id[id];
+        }
+    }
+    return max_job_id > 0 ? jobs_by_id[max_job_id] : NULL;
+}
+
+// Print a line of the jobs listing for job, marked '+' if it is current, the
+// result of current_job; a listing finds that once, not once per line
+static void print_job(const job_t *job, const job_t *current) {
+    const char *state = job_is_done(job)      ? "Done"
+                        : job_is_stopped(job) ? "Stopped"
+                                              : "Running";
+    printf("[%d]%c  %-24s%s\n", job->id, job == current ? '+' : ' ', state,
+           job->command);
+}
+
+// Reap every child that changed state into child_events, until none is
+// left or the queue is full
+static void sigchld_handler(int sig) {
+    (void) sig;
+    int saved_errno = errno;
+    while (child_events_head - child_events_tail < CHILD_EVENTS) {
         int status;
-        pid_t pid = waitpid(-1, &status, 0);
+        pid_t pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED);
         if (pid <= 0) {
             break;
         }
-        // Remove completed job from list
-        bg_job_t **curr = &bg_jobs;
-        while (*curr) {
-            if ((*curr)->pid == pid) {
-                bg_job_t *to_free = *curr;
-                *curr = (*curr)->next;
-                free(to_free);
-                break;
+        unsigned i = child_events_head % CHILD_EVENTS;
+        child_events[i].pid = pid;
+        child_events[i].status = status;
+        child_events_head++;
+    }
+    errno = saved_errno;
+}
+
+static void block_sigchld(sigset_t *old_mask) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, old_mask);
+}
+
+static void restore_sigmask(const sigset_t *old_mask) {
+    sigprocmask(SIG_SETMASK, old_mask, NULL);
+}
+
+// Apply a reaped status to the stage and job of its pid
+static void apply_child_event(pid_t pid, int status) {
+    pid_slot_t *slot = pid_find(pid);
+    if (slot == NULL) {
+        return;
+    }
+    job_t *job = slot->job;
+    job_stage_t *stage = &job->stages[slot->stage];
+    bool was = job_counts_as_bg_running(job);
+
+    if (WIFSTOPPED(status)) {
+        if (stage->state == STAGE_RUNNING) {
+            stage->state = STAGE_STOPPED;
+            job->num_running--;
+        }
+    } else if (WIFCONTINUED(status)) {
+        if (stage->state == STAGE_STOPPED) {
+            stage->state = STAGE_RUNNING;
+            job->num_running++;
+        }
+    } else {
+        if (stage->state == STAGE_RUNNING) {
+            job->num_running--;
+        }
+        stage->state = STAGE_EXITED;
+        stage->status = status;
+        job->num_exited++;
+        pid_remove(slot);
+    }
+    job_changed(job, was);
+
+    // Nobody waits for a background job: a script forgets it at once, and
+    // an interactive shell reports it before the next prompt
+    if (job_is_done(job) && job->background && !shell_is_interactive) {
+        remove_job(job);
+    }
+}
+
+// Apply every queued status to the table. SIGCHLD must be blocked.
+static void process_child_events(void) {
+    for (;;) {
+        while (child_events_tail != child_events_head) {
+            unsigned i = child_events_tail % CHILD_EVENTS;
+            apply_child_event(child_events[i].pid, child_events[i].status);
+            child_events_tail++;
+        }
+        // Reap children the queue had no room for
+        sigchld_handler(SIGCHLD);
+        if (child_events_tail == child_events_head) {
+            return;
+        }
+    }
+}
+
+// Report and forget background jobs that finished. SIGCHLD must be blocked.
+static void notify_done_jobs(void) {
+    job_t *current = current_job();
+    for (int id = 1; id <= max_job_id; id++) {
+        job_t *job = jobs_by_id[id];
+        if (job != NULL && job->background && job_is_done(job)) {
+            print_job(job, current);
+            if (job == current) {
+                current = NULL;
             }
-            curr = &(*curr)->next;
+            remove_job(job);
         }
     }
 }
 
+// Add a background job: it is now tracked until it finishes
+static void add_bg_job(job_t *job) {
+    bool was = job_counts_as_bg_running(job);
+    job->background = true;
+    job_changed(job, was);
+}
+
+// Send SIGCONT to a stopped job and mark its stages as running
+static void continue_job(job_t *job) {
+    bool was = job_counts_as_bg_running(job);
+    for (size_t i = 0; i < job->num_stages; i++) {
+        if (job->stages[i].state == STAGE_STOPPED) {
+            job->stages[i].state = STAGE_RUNNING;
+            job->num_running++;
+        }
+    }
+    job_changed(job, was);
+    if (kill(-job->pgid, SIGCONT) < 0) {
+        perror("kill (SIGCONT)");
+    }
+}
+
+// Run job in the foreground, continuing it first if cont, and wait until it
+// exits or stops. SIGCHLD must be blocked; old_mask is the mask to wait in.
+static void wait_for_job(job_t *job, bool cont, const sigset_t *old_mask) {
+    bool was = job_counts_as_bg_running(job);
+    job->background = false;
+    job_changed(job, was);
+
+    // Give it terminal control, in the modes it stopped in
+    if (shell_is_interactive) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+        if (cont && job->has_tmodes) {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &job->tmodes);
+        }
+    }
+    if (cont) {
+        continue_job(job);
+    }
+
+    process_child_events();
+    while (job->num_running > 0) {
+        sigsuspend(old_mask);
+        process_child_events();
+    }
+
+    // Take back terminal control
+    if (shell_is_interactive) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+        if (job_is_stopped(job)) {
+            job->has_tmodes = tcgetattr(STDIN_FILENO, &job->tmodes) == 0;
+        }
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+    }
+
+    // A stopped job carries on in the background once continued
+    if (job_is_stopped(job)) {
+        job->background = true;
+        print_job(job, current_job());
+    }
+}
+
+// Wait for all background jobs to complete, except stopped ones
+static void wait_all_bg_jobs(void) {
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
+    process_child_events();
+    while (num_bg_running > 0) {
+        sigsuspend(&old_mask);
+        process_child_events();
+    }
+    restore_sigmask(&old_mask);
+}
+
+// Wait until fewer than max_bg_jobs background jobs are running, so that
+// another may start. Stopped jobs do not count. SIGCHLD must be blocked;
+// old_mask is the mask to wait in.
+static void wait_for_bg_slot(const sigset_t *old_mask) {
+    process_child_events();
+    while (max_bg_jobs > 0 && num_bg_running >= max_bg_jobs) {
+        sigsuspend(old_mask);
+        process_child_events();
+    }
+}
+
+// Parse a limit for max_bg_jobs. Returns false if s is not a number.
+static bool parse_max_bg_jobs(const char *s, size_t *max_jobs) {
+    char *end;
+    errno = 0;
+    unsigned long n = strtoul(s, &end, 10);
+    if (*s == '\0' || *s == '-' || *end != '\0' || errno != 0) {
+        return false;
+    }
+    *max_jobs = n;
+    return true;
+}
+
+// Install the SIGCHLD handler and remember the state children start from
+static void setup_job_control(void) {
+    sigprocmask(SIG_SETMASK, NULL, &child_sigmask);
+    if (shell_is_interactive) {
+        tcgetattr(STDIN_FILENO, &shell_tmodes);
+    }
+
+    const char *max_jobs = getenv("CASH_MAX_JOBS");
+    if (max_jobs != NULL && !parse_max_bg_jobs(max_jobs, &max_bg_jobs)) {
+        fprintf(stderr, "cash: CASH_MAX_JOBS: invalid number: %s\n",
+                max_jobs);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, NULL);
+}
+
 static void print_usage(void) {
     printf(u8"\U0001F309 \U0001F30A \U00002600\U0000FE0F "
            u8"cash: The California Shell "
@@ -68,59 +503,225 @@ static void print_usage(void) {
     printf("cd <path>: Change directory (no path = home).\n");
     printf("pwd: Print working directory.\n");
     printf("wait: Wait for all background jobs to complete.\n");
+    printf("jobs: List jobs.\n");
+    printf("jobs -j [n]: Show or set the most background jobs to run at "
+           "once\n");
+    printf("    (0 = no limit; defaults to $CASH_MAX_JOBS).\n");
+    printf("fg [%%n]: Continue job n, or the current job, in the "
+           "foreground.\n");
+    printf("bg [%%n]: Continue job n, or the current job, in the "
+           "background.\n");
+    printf("hash [-r] [name...]: List, reset (-r) or add remembered "
+           "program paths.\n");
+    printf("cat [file...]: Copy files or stdin to stdout.\n");
+    printf("tee [file...]: Copy stdin to stdout and to each file.\n");
+    printf("    (cat and tee take no options; with any, the program from PATH "
+           "runs.)\n");
+    printf("\n");
+    printf("Commands can be joined into a pipeline with '|'.\n");
     printf("\n");
 }
 
-// Resolve program path using PATH environment variable
-static char *resolve_path(const char *program) {
-    if (program == NULL) {
-        return NULL;
+// Search the directories of path for an executable program. Returns its full
+// path, or NULL if no directory has it.
+static char *search_path(const char *path, const char *program) {
+    char full_path[PATH_MAX];
+    size_t program_len = strlen(program);
+
+    while (*path != '\0') {
+        const char *end = strchrnul(path, ':');
+        size_t dir_len = end - path;
+
+        // Build full path: dir + "/" + program, skipping empty entries
+        if (dir_len > 0 && dir_len + 1 + program_len < sizeof(full_path)) {
+            memcpy(full_path, path, dir_len);
+            full_path[dir_len] = '/';
+            memcpy(full_path + dir_len + 1, program, program_len + 1);
+
+            // Check if file exists and is executable
+            if (access(full_path, X_OK) == 0) {
+                return strdup(full_path);
+            }
+        }
+
+        path = *end == ':' ? end + 1 : end;
     }
+    return NULL;
+}
 
-    // If program contains '/', it's already a path
-    if (strchr(program, '/') != NULL) {
-        return strdup(program);
+// Remembered program paths, like the hash table of bash, so that running a
+// program again costs no search of PATH
+typedef struct hash_entry {
+    char *name;
+    char *path;
+    unsigned hits;
+    struct hash_entry *next;
+} hash_entry_t;
+
+#define HASH_MIN_BUCKETS 64
+
+static hash_entry_t **hash_buckets = NULL;
+static size_t hash_num_buckets = 0;
+static size_t hash_num_entries = 0;
+static char *hash_path_env = NULL; // The PATH the entries were found in
+
+// FNV-1a hash of a program name
+static size_t hash_name(const char *name) {
+    size_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *) name; *p; p++) {
+        h = (h ^ *p) * 16777619u;
     }
+    return h;
+}
 
-    // Get PATH environment variable
-    char *path_env = getenv("PATH");
-    if (path_env == NULL) {
-        return strdup(program);
+// Forget every remembered path
+static void hash_clear(void) {
+    for (size_t i = 0; i < hash_num_buckets; i++) {
+        hash_entry_t *entry = hash_buckets[i];
+        while (entry != NULL) {
+            hash_entry_t *next = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+        hash_buckets[i] = NULL;
     }
+    hash_num_entries = 0;
+}
 
-    // Make a copy of PATH since strtok modifies it
-    char *path_copy = strdup(path_env);
-    if (path_copy == NULL) {
+// Empty the table if PATH changed since its entries were found
+static void hash_check_path(void) {
+    const char *path_env = getenv("PATH");
+    bool same = hash_path_env == NULL
+                    ? path_env == NULL
+                    : path_env != NULL && strcmp(hash_path_env, path_env) == 0;
+    if (same) {
+        return;
+    }
+    hash_clear();
+    free(hash_path_env);
+    hash_path_env = path_env != NULL ? strdup(path_env) : NULL;
+}
+
+static hash_entry_t **hash_find(const char *name) {
+    if (hash_num_buckets == 0) {
         return NULL;
     }
+    hash_entry_t **curr = &hash_buckets[hash_name(name) % hash_num_buckets];
+    while (*curr != NULL && strcmp((*curr)->name, name) != 0) {
+        curr = &(*curr)->next;
+    }
+    return curr;
+}
 
-    char *save_ptr = NULL;
-    char *dir = strtok_r(path_copy, ":", &save_ptr);
-    while (dir != NULL) {
-        // Build full path: dir + "/" + program
-        size_t len = strlen(dir) + 1 + strlen(program) + 1;
-        char *full_path = malloc(len);
-        if (full_path == NULL) {
-            free(path_copy);
+// Double the buckets once the table is as full as it has buckets
+static void hash_grow(void) {
+    size_t num_buckets =
+        hash_num_buckets == 0 ? HASH_MIN_BUCKETS : 2 * hash_num_buckets;
+    hash_entry_t **buckets = calloc(num_buckets, sizeof(hash_entry_t *));
+    if (buckets == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < hash_num_buckets; i++) {
+        hash_entry_t *entry = hash_buckets[i];
+        while (entry != NULL) {
+            hash_entry_t *next = entry->next;
+            size_t b = hash_name(entry->name) % num_buckets;
+            entry->next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    free(hash_buckets);
+    hash_buckets = buckets;
+    hash_num_buckets = num_buckets;
+}
+
+// Remember path for name, replacing any earlier path. Returns the entry, or
+// NULL if out of memory.
+static hash_entry_t *hash_insert(const char *name, const char *path) {
+    if (hash_num_entries >= hash_num_buckets) {
+        hash_grow();
+    }
+    hash_entry_t **curr = hash_find(name);
+    if (curr == NULL) {
+        return NULL;
+    }
+    hash_entry_t *entry = *curr;
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(hash_entry_t));
+        if (entry == NULL || (entry->name = strdup(name)) == NULL) {
+            free(entry);
             return NULL;
         }
+        *curr = entry;
+        hash_num_entries++;
+    }
+    char *copy = strdup(path);
+    if (copy != NULL) {
+        free(entry->path);
+        entry->path = copy;
+        entry->hits = 0;
+    }
+    return entry;
+}
+
+// Forget the path of name, e.g. once executing it failed
+static void hash_forget(const char *name) {
+    hash_entry_t **curr = hash_find(name);
+    if (curr == NULL || *curr == NULL) {
+        return;
+    }
+    hash_entry_t *entry = *curr;
+    *curr = entry->next;
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+    hash_num_entries--;
+}
 
-        snprintf(full_path, len, "%s/%s", dir, program);
+// Resolve program path using the hash table, then the PATH environment
+// variable
+static char *resolve_path(const char *program) {
+    if (program == NULL) {
+        return NULL;
+    }
 
-        // Check if file exists and is executable
-        if (access(full_path, X_OK) == 0) {
-            free(path_copy);
-            return full_path;
-        }
+    // If program contains '/', it's already a path
+    if (strchr(program, '/') != NULL) {
+        return strdup(program);
+    }
+
+    hash_check_path();
+    if (hash_path_env == NULL) {
+        return strdup(program);
+    }
 
-        free(full_path);
-        dir = strtok_r(NULL, ":", &save_ptr);
+    hash_entry_t **curr = hash_find(program);
+    if (curr != NULL && *curr != NULL) {
+        (*curr)->hits++;
+        return strdup((*curr)->path);
     }
 
-    free(path_copy);
-    return strdup(program); // Return original if not found
+    char *full_path = search_path(hash_path_env, program);
+    if (full_path == NULL) {
+        return strdup(program); // Return original if not found
+    }
+    hash_entry_t *entry = hash_insert(program, full_path);
+    if (entry != NULL) {
+        entry->hits++;
+    }
+    return full_path;
 }
 
+// Signals that should not affect the shell, but do affect its children
+static const int shell_signals[] = {
+    SIGINT, SIGQUIT, SIGTERM, SIGTSTP, SIGTTIN, SIGTTOU,
+};
+
+#define NUM_SHELL_SIGNALS (sizeof(shell_signals) / sizeof(shell_signals[0]))
+
 // Setup signal handlers for the shell
 static void setup_signal_handlers(void) {
     if (!shell_is_interactive) {
@@ -128,158 +729,736 @@ static void setup_signal_handlers(void) {
     }
 
     // Ignore signals that should not affect the shell
-    signal(SIGINT, SIG_IGN);
-    signal(SIGQUIT, SIG_IGN);
-    signal(SIGTERM, SIG_IGN);
-    signal(SIGTSTP, SIG_IGN);
-    signal(SIGTTIN, SIG_IGN);
-    signal(SIGTTOU, SIG_IGN);
+    for (size_t i = 0; i < NUM_SHELL_SIGNALS; i++) {
+        signal(shell_signals[i], SIG_IGN);
+    }
 }
 
 // Reset signal handlers to default (for child processes)
 static void reset_signal_handlers(void) {
-    signal(SIGINT, SIG_DFL);
-    signal(SIGQUIT, SIG_DFL);
-    signal(SIGTERM, SIG_DFL);
-    signal(SIGTSTP, SIG_DFL);
-    signal(SIGTTIN, SIG_DFL);
-    signal(SIGTTOU, SIG_DFL);
+    for (size_t i = 0; i < NUM_SHELL_SIGNALS; i++) {
+        signal(shell_signals[i], SIG_DFL);
+    }
+    signal(SIGCHLD, SIG_DFL);
+    sigprocmask(SIG_SETMASK, &child_sigmask, NULL);
 }
 
-// Spawn a process to execute a command
-static void spawn_process(const struct command *cmd) {
+// Largest request handed to splice(2) and tee(2) at once
+#define SPLICE_CHUNK (1 << 16)
+
+// Copy everything from in to out. Pipes are spliced and other files are sent
+// with sendfile(2), so the data stays in the kernel; read/write is the
+// fallback for fds neither call accepts. Input from a terminal is always
+// read, since splicing it may wait for more than one line.
+static int copy_fd(int in, int out) {
+    struct stat st;
+    bool in_kernel = fstat(in, &st) == 0 &&
+                     (S_ISFIFO(st.st_mode) || S_ISREG(st.st_mode));
+    bool use_splice = in_kernel;
+    bool use_sendfile = in_kernel;
+    char buf[8192];
+
+    for (;;) {
+        ssize_t n;
+        if (use_splice) {
+            n = splice(in, NULL, out, NULL, SPLICE_CHUNK, SPLICE_F_MOVE);
+            if (n < 0 && errno == EINVAL) {
+                use_splice = false;
+                continue;
+            }
+        } else if (use_sendfile) {
+            n = sendfile(out, in, NULL, SPLICE_CHUNK);
+            if (n < 0 && errno == EINVAL) {
+                use_sendfile = false;
+                continue;
+            }
+        } else {
+            n = read(in, buf, sizeof(buf));
+            for (ssize_t done = 0; n > 0 && done < n;) {
+                ssize_t w = write(out, buf + done, n - done);
+                if (w < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -1;
+                }
+                done += w;
+            }
+        }
+        if (n == 0) {
+            return 0;
+        } else if (n < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+// Move exactly len bytes from the pipe in to out
+static int splice_all(int in, int out, size_t len) {
+    while (len > 0) {
+        ssize_t n = splice(in, NULL, out, NULL, len, SPLICE_F_MOVE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            return -1;
+        }
+        len -= n;
+    }
+    return 0;
+}
+
+// Builtin cat: copy each file, or stdin, to stdout
+static int builtin_cat(char **argv) {
+    int status = EXIT_SUCCESS;
+
+    if (argv[1] == NULL) {
+        if (copy_fd(STDIN_FILENO, STDOUT_FILENO) < 0) {
+            perror("cat");
+            status = EXIT_FAILURE;
+        }
+        return status;
+    }
+
+    for (int i = 1; argv[i] != NULL; i++) {
+        int fd = STDIN_FILENO;
+        if (strcmp(argv[i], "-") != 0) {
+            fd = open(argv[i], O_RDONLY);
+            if (fd < 0) {
+                perror(argv[i]);
+                status = EXIT_FAILURE;
+                continue;
+            }
+        }
+        if (copy_fd(fd, STDOUT_FILENO) < 0) {
+            perror(argv[i]);
+            status = EXIT_FAILURE;
+        }
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+    }
+    return status;
+}
+
+// Copy stdin to stdout and the files by reading it, for when stdin or stdout
+// is not a pipe
+static int tee_copy(const int *fds, int num_fds) {
+    char buf[8192];
+
+    for (;;) {
+        ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+        if (n == 0) {
+            return 0;
+        } else if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (int i = 0; i < num_fds; i++) {
+            for (ssize_t done = 0; done < n;) {
+                ssize_t w = write(fds[i], buf + done, n - done);
+                if (w < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return -1;
+                }
+                done += w;
+            }
+        }
+    }
+}
+
+// Copy the pipe on stdin to the pipe on stdout and to the files without
+// reading it: tee(2) duplicates what is buffered in stdin into stdout, and
+// into a scratch pipe that is spliced to each file but the last. Splicing
+// into the last file then consumes the data from stdin.
+static int tee_splice(const int *fds, int num_fds) {
+    int scratch[2] = {-1, -1};
+    int status = 0;
+
+    if (num_fds > 2) {
+        if (pipe(scratch) < 0) {
+            return -1;
+        }
+        int size = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+        if (size > 0) {
+            fcntl(scratch[1], F_SETPIPE_SZ, size);
+        }
+    }
+
+    for (;;) {
+        ssize_t n = tee(STDIN_FILENO, STDOUT_FILENO, SPLICE_CHUNK, 0);
+        if (n == 0) {
+            break;
+        } else if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            status = -1;
+            break;
+        }
+
+        // The scratch pipe is empty and as large as stdin, so each tee
+        // takes all n bytes
+        for (int i = 1; i < num_fds - 1 && status == 0; i++) {
+            ssize_t m;
+            do {
+                m = tee(STDIN_FILENO, scratch[1], n, 0);
+            } while (m < 0 && errno == EINTR);
+            if (m != n || splice_all(scratch[0], fds[i], n) < 0) {
+                status = -1;
+            }
+        }
+        if (status < 0 || splice_all(STDIN_FILENO, fds[num_fds - 1], n) < 0) {
+            status = -1;
+            break;
+        }
+    }
+
+    if (scratch[0] >= 0) {
+        close(scratch[0]);
+        close(scratch[1]);
+    }
+    return status;
+}
+
+// Builtin tee: copy stdin to stdout and to each file
+static int builtin_tee(char **argv) {
+    int num_fds = 1;
+    while (argv[num_fds] != NULL) {
+        num_fds++;
+    }
+
+    // fds[0] is stdout, then one fd per file
+    int *fds = malloc(num_fds * sizeof(int));
+    if (fds == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    fds[0] = STDOUT_FILENO;
+    for (int i = 1; i < num_fds; i++) {
+        fds[i] = open(argv[i], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fds[i] < 0) {
+            perror(argv[i]);
+            free(fds);
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct stat in_st, out_st;
+    bool pipes = fstat(STDIN_FILENO, &in_st) == 0 && S_ISFIFO(in_st.st_mode) &&
+                 fstat(STDOUT_FILENO, &out_st) == 0 &&
+                 S_ISFIFO(out_st.st_mode);
+
+    int result;
+    if (num_fds == 1) {
+        result = copy_fd(STDIN_FILENO, STDOUT_FILENO);
+    } else if (pipes) {
+        result = tee_splice(fds, num_fds);
+    } else {
+        result = tee_copy(fds, num_fds);
+    }
+    if (result < 0) {
+        perror("tee");
+    }
+
+    for (int i = 1; i < num_fds; i++) {
+        close(fds[i]);
+    }
+    free(fds);
+    return result < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+// Builtins that run as a stage of a pipeline, in a child of their own like
+// any other program, so they can read and write pipes concurrently. They take
+// no options; a command that passes any runs the program from PATH instead.
+typedef struct stage_builtin {
+    const char *name;
+    int (*run)(char **argv);
+    bool dash_is_stdin; // Whether a "-" operand means stdin
+} stage_builtin_t;
+
+static const stage_builtin_t stage_builtins[] = {
+    {"cat", builtin_cat, true},
+    {"tee", builtin_tee, false},
+    {NULL, NULL, false},
+};
+
+// The builtin for argv, or NULL if there is none or argv has an operand the
+// builtin does not take, like an option
+static const stage_builtin_t *find_stage_builtin(char **argv) {
+    const stage_builtin_t *b = stage_builtins;
+    while (b->name != NULL && strcmp(b->name, argv[0]) != 0) {
+        b++;
+    }
+    if (b->name == NULL) {
+        return NULL;
+    }
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (argv[i][0] == '-' && !(b->dash_is_stdin && argv[i][1] == '\0')) {
+            return NULL;
+        }
+    }
+    return b;
+}
+
+// One command of a pipeline
+typedef struct stage {
+    char **argv;
+    char *input_file;
+    char *output_file;
+    const stage_builtin_t *builtin;
+    char *program; // Resolved path, NULL for a builtin
+    pid_t pid;
+    bool forked; // Started by fork_stage rather than posix_spawn
+} stage_t;
+
+// Split cmd at "|" into stages. The argv arrays all point into one array,
+// which is stored in *argv_out for the caller to free along with the stages.
+// Returns the number of stages, or 0 on an empty command or error.
+static size_t parse_pipeline(const struct command *cmd, stage_t **stages_out,
+                             char ***argv_out, bool *background) {
     size_t num_tokens = command_get_num_tokens(cmd);
-    if (num_tokens == 0) {
-        return;
+    size_t num_stages = 1;
+    for (size_t i = 0; i < num_tokens; i++) {
+        if (strcmp(command_get_token_by_index(cmd, i), "|") == 0) {
+            num_stages++;
+        }
     }
 
-    // Build argv array - just copy pointers, no allocation needed for strings
-    char **argv = malloc((num_tokens + 1) * sizeof(char *));
-    if (argv == NULL) {
+    // Build argv arrays - just copy pointers, no allocation needed for
+    // strings. Each stage ends with its own NULL.
+    char **argv = malloc((num_tokens + num_stages) * sizeof(char *));
+    stage_t *stages = calloc(num_stages, sizeof(stage_t));
+    if (argv == NULL || stages == NULL) {
         perror("malloc");
-        return;
+        free(argv);
+        free(stages);
+        return 0;
     }
 
     size_t argv_idx = 0;
-    char *input_file = NULL;
-    char *output_file = NULL;
-    bool background = false;
+    size_t s = 0;
+    stages[0].argv = argv;
+    *background = false;
 
     // Parse tokens
     for (size_t i = 0; i < num_tokens; i++) {
         const char *token = command_get_token_by_index(cmd, i);
 
         if (strcmp(token, "<") == 0 && i + 1 < num_tokens) {
-            input_file = (char *) command_get_token_by_index(cmd, i + 1);
+            stages[s].input_file =
+                (char *) command_get_token_by_index(cmd, i + 1);
             i++;
         } else if (strcmp(token, ">") == 0 && i + 1 < num_tokens) {
-            output_file = (char *) command_get_token_by_index(cmd, i + 1);
+            stages[s].output_file =
+                (char *) command_get_token_by_index(cmd, i + 1);
             i++;
         } else if (strcmp(token, "&") == 0) {
-            background = true;
+            *background = true;
+        } else if (strcmp(token, "|") == 0) {
+            if (stages[s].argv == &argv[argv_idx]) {
+                break;
+            }
+            argv[argv_idx++] = NULL;
+            stages[++s].argv = &argv[argv_idx];
         } else {
             argv[argv_idx++] = (char *) token;
         }
     }
     argv[argv_idx] = NULL;
 
-    if (argv_idx == 0) {
+    // Every stage needs a program; a lone command of only redirections is
+    // ignored as before
+    if (s + 1 < num_stages || stages[s].argv[0] == NULL) {
+        if (num_stages > 1) {
+            fprintf(stderr, "cash: syntax error near '|'\n");
+        }
         free(argv);
-        return;
+        free(stages);
+        return 0;
     }
 
-    // Resolve program path
-    char *program = resolve_path(argv[0]);
-    if (program == NULL) {
-        fprintf(stderr, "%s: command not found\n", argv[0]);
-        free(argv);
-        return;
+    *stages_out = stages;
+    *argv_out = argv;
+    return num_stages;
+}
+
+// Child side of a pipeline stage: join the pipeline's process group, connect
+// the pipes and redirections, then run the stage
+static void run_stage(stage_t *stage, pid_t pgid, int in_fd, int out_fd,
+                      bool background) {
+    // Join the pipeline's process group; the first stage creates it
+    setpgid(0, pgid);
+
+    // Give terminal control to foreground job, while SIGTTOU is still
+    // ignored
+    if (!background && shell_is_interactive && pgid == 0) {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
     }
 
-    // Fork
-    pid_t pid = fork();
+    // Reset signal handlers to default
+    reset_signal_handlers();
+
+    // Connect the pipes; redirections below take precedence
+    if (in_fd != STDIN_FILENO) {
+        dup2(in_fd, STDIN_FILENO);
+        close(in_fd);
+    }
+    if (out_fd != STDOUT_FILENO) {
+        dup2(out_fd, STDOUT_FILENO);
+        close(out_fd);
+    }
+
+    // Handle input redirection
+    if (stage->input_file != NULL) {
+        int fd = open(stage->input_file, O_RDONLY);
+        if (fd < 0) {
+            perror(stage->input_file);
+            _exit(EXIT_FAILURE);
+        }
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+
+    // Handle output redirection
+    if (stage->output_file != NULL) {
+        int fd = open(stage->output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            perror(stage->output_file);
+            _exit(EXIT_FAILURE);
+        }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+    }
+
+    // The child leaves with _exit, since flushing the stdio streams it
+    // shares with the shell would move the script's read offset
+    if (stage->builtin != NULL) {
+        _exit(stage->builtin->run(stage->argv));
+    }
+
+    // Execute
+    execve(stage->program, stage->argv, environ);
+
+    // If execve returns, it failed. Like other shells, exit with 127 if
+    // the program does not exist and 126 if it cannot be run.
+    int exec_errno = errno;
+    perror(stage->program);
+    _exit(exec_errno == ENOENT ? 127 : 126);
+}
+
+// Whether a stage can start with posix_spawn instead of fork. A builtin
+// runs shell code in its child, and a child that takes the terminal needs
+// posix_spawn_file_actions_addtcsetpgrp_np.
+static bool can_spawn(const stage_t *stage, bool take_terminal) {
+    if (stage->builtin != NULL) {
+        return false;
+    }
+#ifdef HAVE_SPAWN_TCSETPGRP
+    (void) take_terminal;
+    return true;
+#else
+    return !take_terminal;
+#endif
+}
+
+// Start a program stage with posix_spawn, which glibc implements with
+// clone(CLONE_VM | CLONE_VFORK): the child runs in the shell's memory until
+// it calls execve, so no page tables are copied however large the shell is.
+// The setup run_stage does after fork is expressed as spawn attributes and
+// file actions. Returns the pid, or -1 after printing an error.
+static pid_t spawn_stage(stage_t *stage, pid_t pgid, int in_fd, int out_fd,
+                         bool take_terminal) {
+    // Open the redirections here rather than with file actions, so that an
+    // error names the file. Like the pipes, they are closed on exec.
+    int input_fd = -1;
+    int output_fd = -1;
+    if (stage->input_file != NULL) {
+        input_fd = open(stage->input_file, O_RDONLY | O_CLOEXEC);
+        if (input_fd < 0) {
+            perror(stage->input_file);
+            return -1;
+        }
+    }
+    if (stage->output_file != NULL) {
+        output_fd = open(stage->output_file,
+                         O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (output_fd < 0) {
+            perror(stage->output_file);
+            if (input_fd >= 0) {
+                close(input_fd);
+            }
+            return -1;
+        }
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    // Join the pipeline's process group with default signal handlers and
+    // the shell's original signal mask
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    for (size_t i = 0; i < NUM_SHELL_SIGNALS; i++) {
+        sigaddset(&defaults, shell_signals[i]);
+    }
+    int err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+                                                  POSIX_SPAWN_SETSIGDEF |
+                                                  POSIX_SPAWN_SETSIGMASK);
+    if (err == 0) {
+        err = posix_spawnattr_setpgroup(&attr, pgid);
+    }
+    if (err == 0) {
+        err = posix_spawnattr_setsigdefault(&attr, &defaults);
+    }
+    if (err == 0) {
+        err = posix_spawnattr_setsigmask(&attr, &child_sigmask);
+    }
+
+#ifdef HAVE_SPAWN_TCSETPGRP
+    // Give terminal control to foreground job, before stdin is replaced
+    if (err == 0 && take_terminal) {
+        err = posix_spawn_file_actions_addtcsetpgrp_np(&actions, STDIN_FILENO);
+    }
+#else
+    (void) take_terminal;
+#endif
+
+    // Connect the pipes, then the redirections, which take precedence
+    int dups[][2] = {
+        {in_fd, STDIN_FILENO},
+        {out_fd, STDOUT_FILENO},
+        {input_fd, STDIN_FILENO},
+        {output_fd, STDOUT_FILENO},
+    };
+    for (size_t i = 0; i < sizeof(dups) / sizeof(dups[0]) && err == 0; i++) {
+        if (dups[i][0] >= 0 && dups[i][0] != dups[i][1]) {
+            err = posix_spawn_file_actions_adddup2(&actions, dups[i][0],
+                                                   dups[i][1]);
+        }
+    }
+
+    pid_t pid = -1;
+    if (err == 0) {
+        err = posix_spawn(&pid, stage->program, &actions, &attr, stage->argv,
+                          environ);
+    }
 
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (input_fd >= 0) {
+        close(input_fd);
+    }
+    if (output_fd >= 0) {
+        close(output_fd);
+    }
+
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", stage->program, strerror(err));
+        // A remembered path that no longer exists is searched again next time
+        if (err == ENOENT) {
+            hash_forget(stage->argv[0]);
+        }
+        return -1;
+    }
+    return pid;
+}
+
+// Start a stage in a forked child, which runs run_stage. pipe_fds is the
+// pipe to the next stage, whose read end the child does not need.
+static pid_t fork_stage(stage_t *stage, pid_t pgid, int in_fd,
+                        const int pipe_fds[2], bool background) {
+    pid_t pid = fork();
     if (pid < 0) {
         perror("fork");
-        free(program);
-        free(argv);
-        return;
     } else if (pid == 0) {
         // CHILD PROCESS
+        if (pipe_fds[0] >= 0) {
+            close(pipe_fds[0]);
+        }
+        run_stage(stage, pgid, in_fd, pipe_fds[1], background);
+    }
+    return pid;
+}
 
-        // Reset signal handlers to default
-        reset_signal_handlers();
+// Start the stages of a pipeline, connected by pipes and in one process
+// group, and wait for all of them unless it runs in background
+static void start_pipeline(stage_t *stages, size_t num_stages,
+                           bool background, const char *command) {
+    // Flush so that no child inherits buffered output of the shell
+    fflush(stdout);
 
-        // Create new process group
-        setpgid(0, 0);
+    // Hold status changes back until the stages are in the job table
+    sigset_t old_mask;
+    block_sigchld(&old_mask);
 
-        // Give terminal control to foreground job
-        if (!background && shell_is_interactive) {
-            tcsetpgrp(STDIN_FILENO, getpgrp());
+    // Throttle background jobs, like xargs -P
+    if (background) {
+        wait_for_bg_slot(&old_mask);
+    }
+
+    // Start the stages left to right. in_fd is the read end of the pipe
+    // from the previous stage; the parent closes each end once it is handed
+    // on. A stage that fails to start leaves its neighbours with a closed
+    // pipe, as if it had exited at once.
+    pid_t pgid = 0;
+    int in_fd = STDIN_FILENO;
+    for (size_t i = 0; i < num_stages; i++) {
+        int pipe_fds[2] = {-1, STDOUT_FILENO};
+        if (i + 1 < num_stages && pipe2(pipe_fds, O_CLOEXEC) < 0) {
+            perror("pipe");
+            break;
         }
 
-        // Handle input redirection
-        if (input_file != NULL) {
-            int fd = open(input_file, O_RDONLY);
-            if (fd < 0) {
-                perror(input_file);
-                exit(EXIT_FAILURE);
-            }
-            dup2(fd, STDIN_FILENO);
-            close(fd);
+        bool take_terminal = !background && shell_is_interactive && pgid == 0;
+        pid_t pid;
+        if (can_spawn(&stages[i], take_terminal)) {
+            pid = spawn_stage(&stages[i], pgid, in_fd, pipe_fds[1],
+                              take_terminal);
+        } else {
+            pid = fork_stage(&stages[i], pgid, in_fd, pipe_fds, background);
+            stages[i].forked = true;
         }
 
-        // Handle output redirection
-        if (output_file != NULL) {
-            int fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-            if (fd < 0) {
-                perror(output_file);
-                exit(EXIT_FAILURE);
+        if (pid > 0) {
+            // Set child's process group too, so that it is in place
+            // whichever of the two runs first
+            if (pgid == 0) {
+                pgid = pid;
             }
-            dup2(fd, STDOUT_FILENO);
-            close(fd);
+            setpgid(pid, pgid);
+            stages[i].pid = pid;
         }
 
-        // Execute
-        execve(program, argv, environ);
+        if (in_fd != STDIN_FILENO) {
+            close(in_fd);
+        }
+        if (pipe_fds[0] >= 0) {
+            close(pipe_fds[1]);
+        }
+        in_fd = pipe_fds[0];
+    }
+    if (in_fd >= 0 && in_fd != STDIN_FILENO) {
+        close(in_fd);
+    }
 
-        // If execve returns, it failed
-        perror(program);
-        exit(EXIT_FAILURE);
-    } else {
-        // PARENT PROCESS
+    pid_t *pids = malloc(num_stages * sizeof(pid_t));
+    job_t *job = NULL;
+    if (pids == NULL) {
+        perror("malloc");
+    } else if (pgid != 0) {
+        for (size_t i = 0; i < num_stages; i++) {
+            pids[i] = stages[i].pid;
+        }
+        job = add_job(pids, num_stages, pgid, command);
+    }
+    free(pids);
 
-        // Set child's process group
-        setpgid(pid, pid);
+    if (job != NULL && background) {
+        // Background job - tracked in the job table until it finishes
+        add_bg_job(job);
+        if (shell_is_interactive) {
+            printf("[%d] %d\n", job->id, (int) job->pgid);
+        }
+    } else if (job != NULL) {
+        // Foreground job - give it terminal control and wait for every stage
+        wait_for_job(job, false, &old_mask);
 
-        if (background) {
-            // Background job - add to tracking list
-            add_bg_job(pid);
-        } else {
-            // Foreground job - give it terminal control and wait
-            if (shell_is_interactive) {
-                tcsetpgrp(STDIN_FILENO, pid);
+        if (job_is_done(job)) {
+            // A remembered path that no longer exists is searched again
+            // next time. posix_spawn reports that itself; a forked program
+            // stage can only tell by exiting with 127 from run_stage.
+            size_t k = 0;
+            for (size_t i = 0; i < num_stages; i++) {
+                if (stages[i].pid <= 0) {
+                    continue;
+                }
+                int status = job->stages[k++].status;
+                if (stages[i].forked && stages[i].builtin == NULL &&
+                    WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+                    hash_forget(stages[i].argv[0]);
+                }
             }
+            remove_job(job);
+        }
+    }
+
+    restore_sigmask(&old_mask);
+}
 
-            int status;
-            waitpid(pid, &status, 0);
+// Spawn a process for every stage of a command's pipeline
+static void spawn_process(const struct command *cmd) {
+    stage_t *stages;
+    char **argv;
+    bool background;
+    size_t num_stages = parse_pipeline(cmd, &stages, &argv, &background);
+    if (num_stages == 0) {
+        return;
+    }
 
-            // Take back terminal control
-            if (shell_is_interactive) {
-                tcsetpgrp(STDIN_FILENO, getpgrp());
+    // Command line, for the job table
+    size_t num_tokens = command_get_num_tokens(cmd);
+    size_t len = 1;
+    for (size_t i = 0; i < num_tokens; i++) {
+        len += strlen(command_get_token_by_index(cmd, i)) + 1;
+    }
+    char *command = malloc(len);
+    if (command == NULL) {
+        perror("malloc");
+        free(stages);
+        free(argv);
+        return;
+    }
+    char *end = command;
+    for (size_t i = 0; i < num_tokens; i++) {
+        if (i > 0) {
+            *end++ = ' ';
+        }
+        end = stpcpy(end, command_get_token_by_index(cmd, i));
+    }
+    *end = '\0';
+
+    // Resolve program paths
+    bool resolved = true;
+    for (size_t i = 0; i < num_stages && resolved; i++) {
+        stages[i].builtin = find_stage_builtin(stages[i].argv);
+        if (stages[i].builtin == NULL) {
+            stages[i].program = resolve_path(stages[i].argv[0]);
+            if (stages[i].program == NULL) {
+                fprintf(stderr, "%s: command not found\n", stages[i].argv[0]);
+                resolved = false;
             }
         }
+    }
+    if (resolved) {
+        start_pipeline(stages, num_stages, background, command);
+    }
 
-        // Clean up
-        free(program);
-        free(argv);
+    // Clean up
+    for (size_t i = 0; i < num_stages; i++) {
+        free(stages[i].program);
     }
+    free(stages);
+    free(argv);
+    free(command);
 }
 
 static bool handle_builtin_command(const struct command *cmd) {
     const char *first_token = command_get_token_by_index(cmd, 0);
     size_t num_tokens = command_get_num_tokens(cmd);
 
+    // Stages of a pipeline run as programs or stage builtins
+    for (size_t i = 1; i < num_tokens; i++) {
+        if (strcmp(command_get_token_by_index(cmd, i), "|") == 0) {
+            return false;
+        }
+    }
+
     // Help command
     if (strcmp(first_token, "help") == 0) {
         print_usage();
@@ -322,6 +1501,119 @@ static bool handle_builtin_command(const struct command *cmd) {
         }
         return true;
     }
+    // Hash command - list, reset or add remembered program paths
+    else if (strcmp(first_token, "hash") == 0) {
+        hash_check_path();
+        if (num_tokens == 1) {
+            if (hash_num_entries == 0) {
+                printf("hash: hash table empty\n");
+                return true;
+            }
+            printf("hits\tcommand\n");
+            for (size_t i = 0; i < hash_num_buckets; i++) {
+                for (hash_entry_t *entry = hash_buckets[i]; entry != NULL;
+                     entry = entry->next) {
+                    printf("%4u\t%s\n", entry->hits, entry->path);
+                }
+            }
+            return true;
+        }
+        for (size_t i = 1; i < num_tokens; i++) {
+            const char *name = command_get_token_by_index(cmd, i);
+            if (strcmp(name, "-r") == 0) {
+                hash_clear();
+                continue;
+            }
+            char *path = NULL;
+            if (strchr(name, '/') == NULL && hash_path_env != NULL) {
+                path = search_path(hash_path_env, name);
+            }
+            if (path == NULL) {
+                fprintf(stderr, "hash: %s: not found\n", name);
+                continue;
+            }
+            hash_insert(name, path);
+            free(path);
+        }
+        return true;
+    }
+    // Jobs command - list jobs, or with -j set the background job limit
+    else if (strcmp(first_token, "jobs") == 0) {
+        if (num_tokens > 1 &&
+            strcmp(command_get_token_by_index(cmd, 1), "-j") == 0) {
+            if (num_tokens == 2) {
+                printf("%zu\n", max_bg_jobs);
+            } else if (!parse_max_bg_jobs(command_get_token_by_index(cmd, 2),
+                                          &max_bg_jobs)) {
+                fprintf(stderr, "jobs: -j: invalid number: %s\n",
+                        command_get_token_by_index(cmd, 2));
+            }
+            return true;
+        }
+
+        sigset_t old_mask;
+        block_sigchld(&old_mask);
+        process_child_events();
+        job_t *current = current_job();
+        for (int id = 1; id <= max_job_id; id++) {
+            job_t *job = jobs_by_id[id];
+            if (job != NULL) {
+                print_job(job, current);
+                if (job_is_done(job)) {
+                    if (job == current) {
+                        current = NULL;
+                    }
+                    remove_job(job);
+                }
+            }
+        }
+        restore_sigmask(&old_mask);
+        return true;
+    }
+    // FG and BG commands - continue a job in the foreground or background
+    else if (strcmp(first_token, "fg") == 0 || strcmp(first_token, "bg") == 0) {
+        sigset_t old_mask;
+        block_sigchld(&old_mask);
+        process_child_events();
+
+        job_t *job = NULL;
+        if (num_tokens == 1) {
+            job = current_job();
+            if (job == NULL) {
+                fprintf(stderr, "%s: no current job\n", first_token);
+            }
+        } else {
+            const char *spec = command_get_token_by_index(cmd, 1);
+            char *spec_end;
+            long id = strtol(spec[0] == '%' ? spec + 1 : spec, &spec_end, 10);
+            if (*spec_end == '\0' && id > 0 && id <= max_job_id) {
+                job = jobs_by_id[id];
+            }
+            if (job == NULL) {
+                fprintf(stderr, "%s: %s: no such job\n", first_token, spec);
+            }
+        }
+
+        if (job != NULL && job_is_done(job)) {
+            fprintf(stderr, "%s: job has terminated\n", first_token);
+            print_job(job, current_job());
+            remove_job(job);
+        } else if (job != NULL && first_token[0] == 'f') {
+            printf("%s\n", job->command);
+            fflush(stdout);
+            wait_for_job(job, true, &old_mask);
+            if (job_is_done(job)) {
+                remove_job(job);
+            }
+        } else if (job != NULL) {
+            continue_job(job);
+            add_bg_job(job);
+            printf("[%d]  %s\n", job->id, job->command);
+        }
+
+        restore_sigmask(&old_mask);
+        return true;
+    }
     // Wait command - wait for all background jobs
     else if (strcmp(first_token, "wait") == 0) {
         wait_all_bg_jobs();
@@ -356,9 +1648,22 @@ int main(int argc, char **argv) {
 
     // Setup signal handlers
     setup_signal_handlers();
+    setup_job_control();
 
     struct command cmd;
-    while (prompt_and_read_command(output_stream, input_stream, &cmd)) {
+    for (;;) {
+        // Apply status changes to the job table, and report background
+        // jobs that finished since the last prompt
+        sigset_t old_mask;
+        block_sigchld(&old_mask);
+        process_child_events();
+        if (shell_is_interactive) {
+            notify_done_jobs();
+        }
+        restore_sigmask(&old_mask);
+        if (!prompt_and_read_command(output_stream, input_stream, &cmd)) {
+            break;
+        }
         if (command_get_num_tokens(&cmd) > 0) {
             if (!handle_builtin_command(&cmd)) {
                 spawn_process(&cmd);
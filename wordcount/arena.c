@@ -0,0 +1,79 @@
+/*
+ * Implementation of the arena interface.
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+
+/* Alignment of every allocation; enough for any scalar type on our targets. */
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+    struct arena_chunk *next;
+    char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+/* Usable bytes in a regular chunk. Larger requests get a chunk of their own. */
+#define CHUNK_SIZE (64 * 1024 - sizeof(struct arena_chunk))
+
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+void arena_init(struct arena *arena) {
+    arena->chunks = NULL;
+    arena->cur = NULL;
+    arena->end = NULL;
+}
+
+void *arena_alloc(struct arena *arena, size_t size) {
+    size = align_up(size);
+    if ((size_t) (arena->end - arena->cur) >= size) {
+        void *p = arena->cur;
+        arena->cur += size;
+        return p;
+    }
+
+    size_t chunk_size = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+    struct arena_chunk *c = malloc(sizeof *c + chunk_size);
+    if (c == NULL) {
+        return NULL;
+    }
+    if (chunk_size > CHUNK_SIZE && arena->chunks != NULL) {
+        /* Oversized: keep bumping in the current chunk afterwards. */
+        c->next = arena->chunks->next;
+        arena->chunks->next = c;
+        return c->data;
+    }
+    c->next = arena->chunks;
+    arena->chunks = c;
+    arena->cur = c->data + size;
+    arena->end = c->data + chunk_size;
+    return c->data;
+}
+
+void arena_absorb(struct arena *dst, struct arena *src) {
+    if (dst->chunks == NULL) {
+        *dst = *src;
+    } else if (src->chunks != NULL) {
+        /* Splice src's chunks behind dst's current one so dst keeps bumping. */
+        struct arena_chunk *last = src->chunks;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = dst->chunks->next;
+        dst->chunks->next = src->chunks;
+    }
+    arena_init(src);
+}
+
+void arena_free(struct arena *arena) {
+    struct arena_chunk *c = arena->chunks;
+    while (c != NULL) {
+        struct arena_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    arena_init(arena);
+}
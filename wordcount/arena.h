@@ -0,0 +1,35 @@
+/*
+ * The arena interface provides a bump allocator. Objects are carved out of
+ * large chunks and can only be released all at once, which suits word count
+ * lists: entries are never removed, only dropped with the whole list.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena_chunk;
+
+struct arena {
+    struct arena_chunk *chunks; /* Most recently allocated chunk first. */
+    char *cur;                  /* Next free byte in chunks. */
+    char *end;                  /* End of chunks. */
+};
+
+/* Initialize an empty arena. Allocates nothing. */
+void arena_init(struct arena *arena);
+
+/*
+ * Returns size bytes from the arena, suitably aligned for any object, or NULL
+ * if out of memory.
+ */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/* Move all of src's memory into dst, leaving src empty. */
+void arena_absorb(struct arena *dst, struct arena *src);
+
+/* Release everything allocated from the arena and leave it empty. */
+void arena_free(struct arena *arena);
+
+#endif /* ARENA_H */
@@ -0,0 +1,115 @@
+#!/bin/sh
+#
+# Benchmark harness for the word count tools, run by `make bench`.
+#
+# For every corpus size and vocabulary size, generates a Zipfian corpus with
+# gen_corpus, both as one file and split into $BENCH_FILES files, and times:
+#   words, lwords      on the single file
+#   pwords, twords     on the single file, in 1..N ranges on 1..N threads
+#   fwords             on the split files with 1..N workers (-j)
+# Each run's output is compared with that of words. Results go to $BENCH_CSV
+# with wall time, throughput, peak RSS and the speedup over the same tool's
+# first thread count.
+#
+# Tunables (environment):
+#   BENCH_SIZES    corpus sizes in MiB           (default "1 4")
+#   BENCH_VOCABS   distinct words in the corpus  (default "1000 5000")
+#   BENCH_THREADS  thread/worker counts          (default 1 2 4 ... nproc)
+#   BENCH_FILES    files in the split corpus     (default 64)
+#   BENCH_DIR      scratch directory             (default bench_data)
+#   BENCH_CSV      output file                   (default bench.csv)
+#
+# words and lwords do a linear list lookup per token, so large vocabularies
+# make them, and the reference run, slow.
+
+set -e
+cd "$(dirname "$0")"
+
+SIZES=${BENCH_SIZES:-"1 4"}
+VOCABS=${BENCH_VOCABS:-"1000 5000"}
+FILES=${BENCH_FILES:-64}
+DIR=${BENCH_DIR:-bench_data}
+CSV=${BENCH_CSV:-bench.csv}
+if [ -z "$BENCH_THREADS" ]; then
+    ncpu=$(getconf _NPROCESSORS_ONLN)
+    BENCH_THREADS=1
+    t=2
+    while [ "$t" -le "$ncpu" ]; do
+        BENCH_THREADS="$BENCH_THREADS $t"
+        t=$((t * 2))
+    done
+fi
+
+mkdir -p "$DIR"
+echo "tool,size_mib,vocab,files,threads,wall_s,mib_per_s,max_rss_kib,speedup,correct" > "$CSV"
+
+# run TOOL THREADS NFILES COMMAND...: time one run and append a CSV row. A
+# run that fails gets a FAILED row and sets failed; the speedups of the rows
+# after a failed first thread count are left empty.
+run() {
+    tool=$1 threads=$2 nfiles=$3
+    shift 3
+    if [ "$threads" = "$first_threads" ]; then
+        base=
+    fi
+    if ! out=$(./bench_run "$DIR/out.txt" "$@"); then
+        echo "$tool,$size,$vocab,$nfiles,$threads,,,,,FAILED" | tee -a "$CSV"
+        failed=1
+        return 0
+    fi
+    set -- $out
+    if [ "$threads" = "$first_threads" ]; then
+        base=$1
+    fi
+    if cmp -s "$DIR/out.txt" "$DIR/ref.txt"; then
+        correct=yes
+    else
+        correct=NO
+    fi
+    awk -v tool="$tool" -v size="$size" -v vocab="$vocab" -v files="$nfiles" \
+        -v threads="$threads" -v wall="$1" -v rss="$2" -v base="$base" \
+        -v correct="$correct" 'BEGIN {
+            speedup = base == "" ? "" : sprintf("%.2f", base / wall)
+            printf "%s,%s,%s,%s,%s,%.4f,%.2f,%s,%s,%s\n", tool, size, vocab,
+                files, threads, wall, size / wall, rss, speedup, correct
+        }' | tee -a "$CSV"
+}
+
+failed=
+first_threads=${BENCH_THREADS%% *}
+for size in $SIZES; do
+    for vocab in $VOCABS; do
+        corpus="$DIR/corpus-$size-$vocab.txt"
+        parts="$DIR/parts-$size-$vocab"
+        if [ ! -f "$corpus" ]; then
+            ./gen_corpus $((size * 1048576)) "$vocab" 1.0 "$size$vocab" > "$corpus"
+            rm -rf "$parts"
+            mkdir -p "$parts"
+            split -n "l/$FILES" "$corpus" "$parts/part-"
+        fi
+        ./words "$corpus" > "$DIR/ref.txt"
+
+        for tool in words lwords; do
+            run "$tool" 1 1 "./$tool" "$corpus"
+        done
+        for tool in pwords twords; do
+            for t in $BENCH_THREADS; do
+                run "$tool" "$t" 1 "./$tool" -j "$t" -s "$t" "$corpus"
+            done
+        done
+        for t in $BENCH_THREADS; do
+            run fwords "$t" "$FILES" ./fwords -j "$t" "$parts"/part-*
+        done
+    done
+done
+
+status=0
+if [ -n "$failed" ]; then
+    echo "bench: some runs failed; see $CSV" >&2
+    status=1
+fi
+if grep -q ',NO$' "$CSV"; then
+    echo "bench: some runs did not match words; see $CSV" >&2
+    status=1
+fi
+exit $status
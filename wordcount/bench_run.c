@@ -0,0 +1,63 @@
+/*
+ * Measurement helper for the word count benchmarks.
+ *
+ * usage: bench_run OUTFILE COMMAND [ARG...]
+ *
+ * Runs COMMAND with its standard output redirected to OUTFILE and, if it
+ * succeeds, prints its wall clock time in seconds and its peak resident set
+ * size in kilobytes (the largest of any process it waited for, as reported
+ * by wait4) on one line.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s OUTFILE COMMAND [ARG...]\n", argv[0]);
+        return 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            perror(argv[1]);
+            _exit(127);
+        }
+        dup2(fd, STDOUT_FILENO);
+        close(fd);
+        execvp(argv[2], &argv[2]);
+        perror(argv[2]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) < 0) {
+        perror("wait4");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: command failed\n", argv[2]);
+        return 1;
+    }
+
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%.6f %ld\n", wall, ru.ru_maxrss);
+    return 0;
+}
@@ -1,107 +1,409 @@
 /*
- * Word count application with one process per input file.
+ * Word count application with a pool of worker processes. With -j N (default:
+ * one per CPU), N children pull input files from a shared work queue, so a few
+ * huge files do not leave the other workers idle. Children send their counts
+ * to the parent over pipes in the binary framing of word_io.h.
+ *
+ * With -x FILE the counts are also kept in a word index (see word_index.h).
+ * Files whose size and modification time match the index are not read again;
+ * only new and changed files go to the workers, and the stored counts of the
+ * rest are merged in. The index is then rewritten for the files given.
+ *
+ * With --approx each worker counts into a sketch (see sketch.h) and sends it
+ * once at the end; the parent adds the sketches up.
  */
 
+#include <errno.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "debug.h"
 #include "word_count.h"
 #include "word_helpers.h"
+#include "sketch.h"
+#include "stats.h"
+#include "word_index.h"
+#include "word_io.h"
 
 /*
- * Read stream of counts and accumulate globally.
- * Expects lines like: "%8d\t%ms\n" (count, tab, word)
+ * Input bytes a worker counts before it streams its partial counts to the
+ * parent and starts a fresh table, bounding the memory each child holds.
  */
-void merge_counts(word_count_list_t *wclist, FILE *count_stream) {
-    char *word;
-    int count;
-    int rv;
-    while ((rv = fscanf(count_stream, "%8d\t%ms\n", &count, &word)) == 2) {
-        add_word_with_count(wclist, word, count);
-        free(word);
-    }
-    if ((rv == EOF) && (feof(count_stream) == 0)) {
-        perror("could not read counts");
-    } else if (rv != EOF) {
-        fprintf(stderr, "read ill-formed count (matched %d)\n", rv);
+#define FLUSH_BYTES ((off_t) 64 << 20)
+
+/*
+ * Body of a worker process under --approx: claim files like run_worker but
+ * count them into a sketch, written to fd when the queue runs dry.
+ */
+static void NO_RETURN run_sketch_worker(char *paths[], int n, int *next,
+                                        int fd, const struct wc_options *opts) {
+    struct sketch sk;
+    word_count_list_t scratch;
+    int rv = 0;
+    int i;
+    if (init_sketch(&sk, opts) != 0) { _exit(1); }
+    init_words(&scratch);
+
+    while ((i = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < n) {
+        if (sketch_count_path(&sk, &scratch, paths[i], 0, -1) != 0) { rv = 1; }
+    }
+    if (sketch_write(&sk, fd) != 0) { rv = 1; }
+    close(fd);
+    if (stats_enabled) { stats_print(); }
+    _exit(rv);
+}
+
+/*
+ * Body of a worker process: claim files from the shared queue until it runs
+ * dry, counting them into a local table that is shipped to fd now and then.
+ * *next is the index of the next unclaimed path, shared by all workers.
+ */
+static void NO_RETURN run_worker(char *paths[], int n, int *next, int fd,
+                                 const struct wc_options *opts) {
+    word_count_list_t local;
+    off_t pending = 0;
+    int rv = 0;
+    int i;
+    init_words(&local);
+
+    while ((i = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED)) < n) {
+        struct stat st;
+        if (stat(paths[i], &st) == 0) { pending += st.st_size; }
+        bool ok = count_path(&local, paths[i], opts) == 0;
+        if (!ok) { rv = 1; }
+
+        if (opts->index != NULL) {
+            /* The index needs every file's counts apart: send each alone. */
+            if (ok && write_file_words_binary(&local, i, fd) != 0) { _exit(1); }
+            free_words(&local);
+            init_words(&local);
+            continue;
+        }
+
+        if (pending >= FLUSH_BYTES) {
+            if (write_words_binary(&local, fd) != 0) { _exit(1); }
+            free_words(&local);
+            init_words(&local);
+            pending = 0;
+        }
     }
+    if (write_words_binary(&local, fd) != 0) { rv = 1; }
+    close(fd);
+    if (stats_enabled) { stats_print(); }
+    _exit(rv);
 }
 
-static int run_child_and_pipe(const char *path, int pfd[2]) {
+/*
+ * Fork a worker with a pipe for its counts. Returns the pid, with the read
+ * end in *rfd, or -1 on failure.
+ */
+static pid_t start_worker(char *paths[], int n, int *next, int *rfd,
+                          const struct wc_options *opts) {
+    int pfd[2];
     if (pipe(pfd) < 0) { perror("pipe"); return -1; }
     pid_t pid = fork();
     if (pid < 0) { perror("fork"); close(pfd[0]); close(pfd[1]); return -1; }
 
     if (pid == 0) {
-        /* Child: close read end, process file, emit to write end. */
+        /* Child: close read end, count files, emit to write end. */
         close(pfd[0]);
-
-        FILE *in = fopen(path, "r");
-        if (!in) { perror(path); _exit(1); }
-
-        word_count_list_t local;
-        init_words(&local);
-        count_words(&local, in);
-        fclose(in);
-
-        FILE *out = fdopen(pfd[1], "w");
-        if (!out) { perror("fdopen"); _exit(1); }
-        fprint_words(&local, out);
-        fclose(out);           /* also closes pfd[1] */
-        _exit(0);
+        if (opts->approx) { run_sketch_worker(paths, n, next, pfd[1], opts); }
+        run_worker(paths, n, next, pfd[1], opts);
     }
 
     /* Parent: close write end, keep read end for merge. */
     close(pfd[1]);
+    *rfd = pfd[0];
     return pid;
 }
 
+/* Per-file tables that marker frames from the workers select between. */
+struct file_counts {
+    word_count_list_t *lists;
+    bool *counted; /* A worker sent counts for the file. */
+    int n;
+};
+
+static word_count_list_t *select_file(void *aux, uint32_t file) {
+    struct file_counts *fc = aux;
+    if (file >= (uint32_t) fc->n) { return NULL; }
+    fc->counted[file] = true;
+    return &fc->lists[file];
+}
+
+/*
+ * Count the n files in paths with the worker pool, merging into dst, or into
+ * the tables of per_file if it is not NULL. Returns 0, or -1 if no worker
+ * could be started.
+ */
+static int count_files(char *paths[], int n, const struct wc_options *opts,
+                       word_count_list_t *dst, struct file_counts *per_file) {
+    int jobs = opts->jobs < n ? opts->jobs : n;
+
+    /* The work queue is a shared counter: workers claim files in turn. */
+    int *next = mmap(NULL, sizeof *next, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    struct word_reader *readers = calloc(jobs, sizeof *readers);
+    struct pollfd *pfds = calloc(jobs, sizeof *pfds);
+    pid_t *pids = calloc(jobs, sizeof *pids);
+    if (next == MAP_FAILED || !readers || !pfds || !pids) {
+        fprintf(stderr, "oom\n");
+        return -1;
+    }
+    *next = 0;
+
+    int running = 0;
+    for (int i = 0; i < jobs; i++) {
+        pids[i] = start_worker(paths, n, next, &pfds[i].fd, opts);
+        if (pids[i] < 0) {
+            pfds[i].fd = -1;
+            continue;
+        }
+        if (word_reader_init(&readers[i], pfds[i].fd) != 0) {
+            /* Closing the pipe lets the worker die of EPIPE, not block. */
+            close(pfds[i].fd);
+            pfds[i].fd = -1;
+            continue;
+        }
+        if (per_file != NULL) {
+            readers[i].select = select_file;
+            readers[i].aux = per_file;
+        }
+        pfds[i].events = POLLIN;
+        running++;
+    }
+    if (running == 0) { return -1; }
+
+    /* Merge counts from whichever workers have some ready. */
+    while (running > 0) {
+        if (poll(pfds, jobs, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            perror("poll");
+            return -1;
+        }
+        for (int i = 0; i < jobs; i++) {
+            if (pfds[i].fd < 0 || pfds[i].revents == 0) { continue; }
+            uint64_t start = stats_begin();
+            int more = word_reader_merge(&readers[i], dst);
+            stats_end(STATS_MERGE, start);
+            if (more <= 0) {
+                word_reader_destroy(&readers[i]);
+                close(pfds[i].fd);
+                pfds[i].fd = -1;
+                running--;
+            }
+        }
+    }
+
+    /* Reap children. */
+    for (int i = 0; i < jobs; i++) {
+        if (pids[i] > 0) {
+            int status;
+            (void)waitpid(pids[i], &status, 0);
+        }
+    }
+    munmap(next, sizeof *next);
+    free(readers);
+    free(pfds);
+    free(pids);
+    return 0;
+}
+
+/*
+ * Count the n files in paths with the worker pool into sk, reading each
+ * worker's sketch in turn. Returns 0, or -1 if no worker could be started
+ * or a sketch could not be read.
+ */
+static int sketch_files(char *paths[], int n, const struct wc_options *opts,
+                        struct sketch *sk) {
+    int jobs = opts->jobs < n ? opts->jobs : n;
+    int *next = mmap(NULL, sizeof *next, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    int *fds = calloc(jobs, sizeof *fds);
+    pid_t *pids = calloc(jobs, sizeof *pids);
+    if (next == MAP_FAILED || !fds || !pids) {
+        fprintf(stderr, "oom\n");
+        return -1;
+    }
+    *next = 0;
+
+    int running = 0;
+    for (int i = 0; i < jobs; i++) {
+        pids[i] = start_worker(paths, n, next, &fds[i], opts);
+        if (pids[i] > 0) { running++; }
+    }
+    if (running == 0) { return -1; }
+
+    /* A worker that is not read yet just waits on its full pipe. */
+    int rv = 0;
+    for (int i = 0; i < jobs; i++) {
+        if (pids[i] < 0) { continue; }
+        if (sketch_read_merge(sk, fds[i]) != 0) { rv = -1; }
+        close(fds[i]);
+        int status;
+        (void)waitpid(pids[i], &status, 0);
+    }
+    munmap(next, sizeof *next);
+    free(fds);
+    free(pids);
+    return rv;
+}
+
+static void add_entry(word_count_t *wc, void *aux) {
+    add_word_with_count(aux, wc->word, wc->count);
+}
+
+/*
+ * Count the n files in paths into dst through the index at opts->index:
+ * reuse the stored counts of unchanged files, count the others with the pool
+ * and write the index back. Returns 0, or -1 if the index cannot be used.
+ */
+static int update_index(char *paths[], int n, const struct wc_options *opts,
+                        word_count_list_t *dst) {
+    struct word_index ix;
+    uint32_t flags = opts->utf8 ? WORD_INDEX_UTF8 : 0;
+    if (word_index_open(&ix, opts->index) != 0) { return -1; }
+    if (ix.hdr->flags != flags) {
+        /* Tokenized the other way: count everything again. */
+        word_index_close(&ix);
+    }
+
+    uint32_t nold = ix.hdr->nfiles;
+    struct word_index_source *src = calloc(n, sizeof *src);
+    char **todo = calloc(n, sizeof *todo);
+    int *todo_src = calloc(n, sizeof *todo_src);
+    bool *reused = calloc(nold + 1, sizeof *reused);
+    struct file_counts fc = {calloc(n, sizeof *fc.lists),
+                             calloc(n, sizeof *fc.counted), 0};
+    int nsrc = 0, nreused = 0;
+    int rv = -1;
+    if (!src || !todo || !todo_src || !reused || !fc.lists || !fc.counted) {
+        fprintf(stderr, "oom\n");
+        goto out;
+    }
+
+    /* Sort the files into those the index still covers and the rest. */
+    for (int i = 0; i < n; i++) {
+        struct word_index_source *s = &src[nsrc];
+        if (stat(paths[i], &s->st) != 0) {
+            perror(paths[i]);
+            continue;
+        }
+        s->path = paths[i];
+        s->old = word_index_lookup(&ix, paths[i], &s->st);
+        if (s->old != NULL) {
+            if (!reused[s->old - ix.files]) { nreused++; }
+            reused[s->old - ix.files] = true;
+        } else {
+            init_words(&fc.lists[fc.n]);
+            todo[fc.n] = paths[i];
+            todo_src[fc.n++] = nsrc;
+        }
+        nsrc++;
+    }
+
+    if (fc.n == 0 && nsrc == nreused && (uint32_t) nreused == nold) {
+        /* Same files, none changed: the stored totals are the answer. */
+        word_index_add_totals(&ix, dst);
+        rv = 0;
+        goto out;
+    }
+
+    if (fc.n > 0 && count_files(todo, fc.n, opts, dst, &fc) != 0) { goto out; }
+    for (int i = 0; i < nsrc; i++) {
+        if (src[i].old != NULL &&
+            word_index_add_file(&ix, src[i].old, dst) != 0) {
+            goto out;
+        }
+    }
+    for (int i = 0; i < fc.n; i++) {
+        if (fc.counted[i]) {
+            wordcount_foreach(&fc.lists[i], add_entry, dst);
+            src[todo_src[i]].counts = &fc.lists[i];
+        }
+    }
+
+    /* Files that could not be counted stay out of the index. */
+    int nkept = 0;
+    for (int i = 0; i < nsrc; i++) {
+        if (src[i].old != NULL || src[i].counts != NULL) {
+            src[nkept++] = src[i];
+        }
+    }
+    rv = word_index_write(opts->index, dst, &ix, src, nkept, flags);
+
+out:
+    for (int i = 0; i < fc.n; i++) { free_words(&fc.lists[i]); }
+    free(fc.lists);
+    free(fc.counted);
+    free(reused);
+    free(todo_src);
+    free(todo);
+    free(src);
+    word_index_close(&ix);
+    return rv;
+}
+
+/* Count stdin, or the files in paths, into a sketch and print the top. */
+static int approx_words(char *paths[], int npaths,
+                        const struct wc_options *opts) {
+    struct sketch sk;
+    int rv = 0;
+    if (init_sketch(&sk, opts) != 0) { return 1; }
+
+    if (npaths == 0) {
+        word_count_list_t scratch;
+        init_words(&scratch);
+        if (sketch_count_path(&sk, &scratch, NULL, 0, -1) != 0) { rv = 1; }
+        free_words(&scratch);
+    } else if (sketch_files(paths, npaths, opts, &sk) != 0) {
+        rv = 1;
+    }
+    if (rv == 0) { output_sketch(&sk, opts, stdout); }
+    sketch_free(&sk);
+    return rv;
+}
+
 int main(int argc, char *argv[]) {
+    struct wc_options opts;
+    int first_file = parse_options(argc, argv, "j:k:mx:", &opts);
+    if (first_file < 0) { return 1; }
+    if (opts.approx) {
+        if (opts.index != NULL) {
+            fprintf(stderr, "%s: --approx cannot use -x\n", argv[0]);
+            return 1;
+        }
+        return approx_words(&argv[first_file], argc - first_file, &opts);
+    }
+
     word_count_list_t word_counts;
     init_words(&word_counts);
 
-    if (argc <= 1) {
-        count_words(&word_counts, stdin);
-    } else {
-        int n = argc - 1;
-        int *rfds = calloc(n, sizeof *rfds);
-        pid_t *pids = calloc(n, sizeof *pids);
-        if (!rfds || !pids) { fprintf(stderr, "oom\n"); return 1; }
-
-        for (int i = 0; i < n; i++) {
-            int pfd[2];
-            pid_t pid = run_child_and_pipe(argv[i + 1], pfd);
-            if (pid < 0) { rfds[i] = -1; pids[i] = -1; continue; }
-            rfds[i] = pfd[0];  /* parent read end */
-            pids[i] = pid;
-        }
-
-        /* Merge each child's stream, then close read end. */
-        for (int i = 0; i < n; i++) {
-            if (rfds[i] >= 0) {
-                FILE *rin = fdopen(rfds[i], "r");
-                if (!rin) { perror("fdopen"); close(rfds[i]); continue; }
-                merge_counts(&word_counts, rin);
-                fclose(rin);   /* closes rfds[i] */
-            }
+    if (first_file >= argc) {
+        if (opts.index != NULL) {
+            fprintf(stderr, "%s: -x needs input files\n", argv[0]);
+            return 1;
         }
-
-        /* Reap children. */
-        for (int i = 0; i < n; i++) {
-            if (pids[i] > 0) {
-                int status;
-                (void)waitpid(pids[i], &status, 0);
-            }
+        count_words(&word_counts, stdin);
+    } else if (opts.index != NULL) {
+        if (update_index(&argv[first_file], argc - first_file, &opts,
+                         &word_counts) != 0) {
+            return 1;
         }
-        free(rfds);
-        free(pids);
+    } else if (count_files(&argv[first_file], argc - first_file, &opts,
+                           &word_counts, NULL) != 0) {
+        return 1;
     }
 
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
+    output_words(&word_counts, &opts, stdout);
+    free_words(&word_counts);
     return 0;
 }
@@ -0,0 +1,112 @@
+/*
+ * Synthetic corpus generator for the word count benchmarks.
+ *
+ * usage: gen_corpus BYTES VOCAB [SKEW [SEED]]
+ *
+ * Writes about BYTES bytes of text to stdout, made of words drawn from a
+ * vocabulary of VOCAB distinct words with Zipfian frequencies: the word of
+ * rank r is picked with probability proportional to 1 / r^SKEW (default 1.0).
+ * Some words are capitalized and some followed by punctuation so that the
+ * tokenizer's case folding and boundary handling are exercised too.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint64_t rng_state;
+
+/* xorshift64* pseudo-random numbers; deterministic for a given seed. */
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ULL;
+}
+
+/* Uniform double in [0, 1). */
+static double rng_double(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Spell the word of the given rank: rank + 26 in base 26 with letters as
+ * digits, so every word has at least two letters and all are distinct.
+ */
+static int spell(unsigned long rank, char *buf) {
+    char tmp[16];
+    int n = 0;
+    unsigned long v = rank + 26;
+    while (v > 0) {
+        tmp[n++] = 'a' + v % 26;
+        v /= 26;
+    }
+    for (int i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 5) {
+        fprintf(stderr, "usage: %s BYTES VOCAB [SKEW [SEED]]\n", argv[0]);
+        return 1;
+    }
+    unsigned long long bytes = strtoull(argv[1], NULL, 10);
+    unsigned long vocab = strtoul(argv[2], NULL, 10);
+    double skew = argc > 3 ? atof(argv[3]) : 1.0;
+    rng_state = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    if (rng_state == 0) {
+        rng_state = 1;
+    }
+    if (vocab == 0) {
+        fprintf(stderr, "%s: VOCAB must be positive\n", argv[0]);
+        return 1;
+    }
+
+    /* Cumulative distribution over ranks, searched by bisection. */
+    double *cdf = malloc(vocab * sizeof *cdf);
+    if (cdf == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    double sum = 0;
+    for (unsigned long r = 0; r < vocab; r++) {
+        sum += 1.0 / pow(r + 1, skew);
+        cdf[r] = sum;
+    }
+
+    unsigned long long written = 0;
+    int on_line = 0;
+    char word[20];
+    while (written < bytes) {
+        double x = rng_double() * sum;
+        unsigned long lo = 0, hi = vocab - 1;
+        while (lo < hi) {
+            unsigned long mid = lo + (hi - lo) / 2;
+            if (cdf[mid] <= x) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        int n = spell(lo, word);
+        uint64_t r = rng_next();
+        if (r % 10 == 0) {
+            word[0] -= 'a' - 'A';
+        }
+        if ((r >> 8) % 16 == 0) {
+            word[n++] = ",.;:!?"[(r >> 16) % 6];
+        }
+        word[n++] = (++on_line % 12 == 0) ? '\n' : ' ';
+        fwrite(word, 1, n, stdout);
+        written += n;
+    }
+    if (on_line % 12 != 0) {
+        putchar('\n');
+    }
+    free(cdf);
+    return ferror(stdout) ? 1 : 0;
+}
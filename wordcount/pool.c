@@ -0,0 +1,217 @@
+/*
+ * Implementation of the pool interface. Each deque is a circular buffer under
+ * its own mutex; the owner pushes and pops at the tail, thieves take from the
+ * head. A pool-wide mutex guards the task counters that idle workers and
+ * pool_wait sleep on.
+ */
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct pool_task {
+    pool_fn *fn;
+    void *arg;
+};
+
+struct pool_worker {
+    pthread_mutex_t lock; /* Guards the deque. */
+    struct pool_task *tasks;
+    size_t head;          /* Oldest task. */
+    size_t len;
+    size_t cap;
+    struct pool *pool;
+    int id;
+    pthread_t thread;
+} __attribute__((aligned(64)));
+
+struct pool {
+    struct pool_worker *workers;
+    int nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;  /* A task was queued, or the pool is stopping. */
+    pthread_cond_t idle;  /* unfinished dropped to zero. */
+    size_t queued;        /* Tasks sitting in deques. */
+    size_t unfinished;    /* Tasks submitted and not yet done. */
+    unsigned int next;    /* Deque for the next task from outside. */
+    bool stop;
+};
+
+/* Append a task at the tail of w's deque. Caller holds w->lock. */
+static int deque_push(struct pool_worker *w, struct pool_task t) {
+    if (w->len == w->cap) {
+        size_t cap = w->cap ? 2 * w->cap : 64;
+        struct pool_task *tasks = malloc(cap * sizeof *tasks);
+        if (tasks == NULL) {
+            return -1;
+        }
+        for (size_t i = 0; i < w->len; i++) {
+            tasks[i] = w->tasks[(w->head + i) % w->cap];
+        }
+        free(w->tasks);
+        w->tasks = tasks;
+        w->head = 0;
+        w->cap = cap;
+    }
+    w->tasks[(w->head + w->len) % w->cap] = t;
+    w->len++;
+    return 0;
+}
+
+/* Take the newest task of w's deque if own, else the oldest one. */
+static bool deque_take(struct pool_worker *w, bool own, struct pool_task *t) {
+    bool found = false;
+    pthread_mutex_lock(&w->lock);
+    if (w->len > 0) {
+        if (own) {
+            *t = w->tasks[(w->head + w->len - 1) % w->cap];
+        } else {
+            *t = w->tasks[w->head];
+            w->head = (w->head + 1) % w->cap;
+        }
+        w->len--;
+        found = true;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+/* Find a task for worker id: its own first, then the other workers' in turn. */
+static bool take_task(struct pool *p, int id, struct pool_task *t) {
+    for (int k = 0; k < p->nthreads; k++) {
+        if (deque_take(&p->workers[(id + k) % p->nthreads], k == 0, t)) {
+            pthread_mutex_lock(&p->lock);
+            p->queued--;
+            pthread_mutex_unlock(&p->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *worker_main(void *arg) {
+    struct pool_worker *w = arg;
+    struct pool *p = w->pool;
+    struct pool_task t;
+
+    for (;;) {
+        if (take_task(p, w->id, &t)) {
+            t.fn(t.arg, w->id);
+            pthread_mutex_lock(&p->lock);
+            if (--p->unfinished == 0) {
+                pthread_cond_broadcast(&p->idle);
+            }
+            pthread_mutex_unlock(&p->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        while (p->queued == 0 && !p->stop) {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+        bool done = p->stop && p->queued == 0;
+        bool racing = p->queued > 0;
+        pthread_mutex_unlock(&p->lock);
+        if (done) {
+            return NULL;
+        }
+        if (racing) {
+            /* Counted but taken by another worker between our scans. */
+            sched_yield();
+        }
+    }
+}
+
+/* Tell the workers to exit once the deques are empty and join the first n. */
+static void stop_workers(struct pool *p, int n) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = true;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < n; i++) {
+        pthread_join(p->workers[i].thread, NULL);
+    }
+}
+
+struct pool *pool_create(int nthreads) {
+    struct pool *p = calloc(1, sizeof *p);
+    if (p == NULL || nthreads < 1 ||
+        (p->workers = calloc(nthreads, sizeof *p->workers)) == NULL) {
+        fprintf(stderr, "oom\n");
+        free(p);
+        return NULL;
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    for (int i = 0; i < nthreads; i++) {
+        pthread_mutex_init(&p->workers[i].lock, NULL);
+        p->workers[i].pool = p;
+        p->workers[i].id = i;
+    }
+    p->nthreads = nthreads;
+
+    for (int i = 0; i < nthreads; i++) {
+        int err = pthread_create(&p->workers[i].thread, NULL, worker_main,
+                                 &p->workers[i]);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            stop_workers(p, i);
+            free(p->workers);
+            free(p);
+            return NULL;
+        }
+    }
+    return p;
+}
+
+int pool_size(const struct pool *pool) {
+    return pool->nthreads;
+}
+
+int pool_submit(struct pool *pool, int worker, pool_fn *fn, void *arg) {
+    struct pool_task t = {fn, arg};
+    int rv;
+
+    /* Push and count under the pool lock, so workers see both or neither. */
+    pthread_mutex_lock(&pool->lock);
+    if (worker < 0) {
+        worker = pool->next++ % pool->nthreads;
+    }
+    struct pool_worker *w = &pool->workers[worker];
+    pthread_mutex_lock(&w->lock);
+    rv = deque_push(w, t);
+    pthread_mutex_unlock(&w->lock);
+    if (rv == 0) {
+        pool->queued++;
+        pool->unfinished++;
+        pthread_cond_signal(&pool->work);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (rv != 0) {
+        fprintf(stderr, "oom\n");
+    }
+    return rv;
+}
+
+void pool_wait(struct pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->unfinished > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(struct pool *pool) {
+    stop_workers(pool, pool->nthreads);
+    for (int i = 0; i < pool->nthreads; i++) {
+        free(pool->workers[i].tasks);
+    }
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,42 @@
+/*
+ * The pool interface runs tasks on a fixed set of worker threads. Every
+ * worker has its own deque of tasks: it takes its newest task first and,
+ * when its deque runs dry, steals the oldest task of another worker. Tasks
+ * may submit further tasks, which land on the submitting worker's deque, so
+ * a task that splits its work lets idle workers pick up the pieces.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+/* A task body. worker is the index of the thread running it. */
+typedef void pool_fn(void *arg, int worker);
+
+struct pool;
+
+/*
+ * Starts a pool of nthreads workers. Returns NULL (after printing an error)
+ * if the pool or any of its threads could not be created.
+ */
+struct pool *pool_create(int nthreads);
+
+/* Number of worker threads, and so the bound on worker indices. */
+int pool_size(const struct pool *pool);
+
+/*
+ * Queues fn(arg) on the deque of the given worker, or spreads tasks over the
+ * workers in turn if worker is negative (when submitting from outside the
+ * pool). Returns 0, or -1 if out of memory.
+ */
+int pool_submit(struct pool *pool, int worker, pool_fn *fn, void *arg);
+
+/*
+ * Waits until every submitted task, including those submitted by tasks, has
+ * finished. Must not be called from a task.
+ */
+void pool_wait(struct pool *pool);
+
+/* Waits for queued tasks, stops the workers and frees the pool. */
+void pool_destroy(struct pool *pool);
+
+#endif /* POOL_H */
@@ -1,74 +1,324 @@
 /*
- * Word count application with one thread per input file.
+ * Word count application on a work-stealing pool of threads (see pool.h),
+ * -j N of them or one per CPU by default. Every input file is a task. A file
+ * larger than CHUNK_BYTES, or with -s N every file, is split at word
+ * boundaries into byte range tasks that idle threads steal, so one large
+ * file does not leave a single thread counting while the others wait. With
+ * -m the files are mapped into memory instead of read through stdio.
+ *
+ * Built as pwords, every thread counts straight into one shared table. Built
+ * with THREAD_LOCAL #define'd (the twords executable), each pool thread counts
+ * into a private table and the tables are combined afterwards by a parallel
+ * tree reduction, so no lock is taken while counting.
+ *
+ * With --approx each pool thread counts into its own sketch (see sketch.h)
+ * instead, and the sketches are added up at the end.
+ *
+ * With -a N the files are not split into tasks; a reader (see reader.h)
+ * keeps N reads in flight and every pool thread counts the buffers it fills.
  */
 
-#include <pthread.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "pool.h"
+#include "reader.h"
+#include "sketch.h"
 #include "word_count.h"
 #include "word_helpers.h"
 
-struct thread_arg
+/* Files larger than this are counted as several byte range tasks. */
+#define CHUNK_BYTES ((off_t)16 << 20)
+
+struct range
 {
     const char *path;
-    word_count_list_t *dst;
+    off_t start;              /* Byte range of path to count; len < 0 */
+    off_t len;                /* means the whole file. */
 };
 
-static void *worker(void *arg)
+static struct wc_options opts;
+static struct pool *pool;
+static struct reader *reader; /* -a */
+static bool read_failed;       /* Set when reader_count fails. */
+
+/*
+ * Counted into: one table per pool thread under THREAD_LOCAL, else one. With
+ * --approx, one sketch per pool thread, each with a table as scratch space.
+ */
+static word_count_list_t *tables;
+static struct sketch *sketches;
+
+static word_count_list_t *table_for(int worker)
 {
-    struct thread_arg *a = (struct thread_arg *)arg;
-    FILE *f = fopen(a->path, "r");
+#ifndef THREAD_LOCAL
+    if (!opts.approx)
+        return &tables[0];
+#endif
+    return &tables[worker];
+}
+
+static void count_range(word_count_list_t *dst, const struct range *r)
+{
+    if (r->len == 0)
+        return;
+    if (opts.mapped)
+    {
+        count_words_mapped_range(dst, r->path, r->start, r->len);
+        return;
+    }
+    FILE *f = fopen(r->path, "r");
     if (!f)
     {
-        perror(a->path);
-        return NULL;
+        perror(r->path);
+        return;
     }
-    count_words(a->dst, f); /* tokenization + add_word happen here */
+    if (r->start != 0 && fseeko(f, r->start, SEEK_SET) != 0)
+        perror(r->path);
+    else
+        count_words_limit(dst, f, r->len); /* tokenize + add_word */
     fclose(f);
-    return NULL;
 }
 
-int main(int argc, char *argv[])
+/*
+ * Fill ranges[0..nsplit) with nsplit byte ranges covering path. Each boundary
+ * is moved forward to the next non-alpha byte so that no word is cut in half
+ * between two tasks. Empty ranges are fine.
+ */
+static void split_file(const char *path, int nsplit, struct range *ranges)
 {
-    word_count_list_t word_counts;
-    init_words(&word_counts);
+    struct stat st;
+    FILE *f = fopen(path, "r");
+    for (int k = 0; k < nsplit; k++)
+    {
+        ranges[k].path = path;
+        ranges[k].start = 0;
+        ranges[k].len = k == 0 ? -1 : 0;
+    }
+    if (!f || fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        /* Let the first range report the error or read it in one go. */
+        if (f)
+            fclose(f);
+        return;
+    }
 
-    if (argc <= 1)
+    off_t prev = 0;
+    for (int k = 1; k <= nsplit; k++)
     {
-        count_words(&word_counts, stdin);
+        off_t b = st.st_size;
+        if (k < nsplit)
+            b = next_word_boundary(f, st.st_size / nsplit * k);
+        if (b < prev)
+            b = prev;
+        ranges[k - 1].start = prev;
+        ranges[k - 1].len = b - prev;
+        prev = b;
     }
+    fclose(f);
+}
+
+/* Count r on the given worker, into its sketch with --approx. */
+static void count_on(int worker, const struct range *r)
+{
+    if (opts.approx && r->len != 0)
+        sketch_count_path(&sketches[worker], table_for(worker), r->path,
+                          r->start, r->len);
     else
+        count_range(table_for(worker), r);
+}
+
+static void range_task(void *arg, int worker)
+{
+    struct range *r = (struct range *)arg;
+    count_on(worker, r);
+    free(r);
+}
+
+/*
+ * Split a file into ranges, queue all but the first on this thread's deque
+ * for others to steal, and count the first one here.
+ */
+static void file_task(void *arg, int worker)
+{
+    const char *path = (const char *)arg;
+    struct stat st;
+    int nsplit = opts.split;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_size / CHUNK_BYTES >= nsplit)
+        nsplit = st.st_size / CHUNK_BYTES + 1;
+
+    struct range *ranges = calloc(nsplit, sizeof *ranges);
+    if (!ranges)
+    {
+        fprintf(stderr, "oom\n");
+        return;
+    }
+    split_file(path, nsplit, ranges);
+    for (int k = 1; k < nsplit; k++)
+    {
+        if (ranges[k].len == 0)
+            continue;
+        struct range *r = malloc(sizeof *r);
+        if (r)
+            *r = ranges[k];
+        if (!r || pool_submit(pool, worker, range_task, r) != 0)
+        {
+            free(r);
+            count_on(worker, &ranges[k]);
+        }
+    }
+    count_on(worker, &ranges[0]);
+    free(ranges);
+}
+
+/* Count buffers from the reader until every file is done. */
+static void reader_task(void *arg, int worker)
+{
+    (void)arg;
+    if (reader_count(reader, table_for(worker)) != 0)
+        __atomic_store_n(&read_failed, true, __ATOMIC_RELAXED);
+}
+
+#ifdef THREAD_LOCAL
+struct merge_pair
+{
+    word_count_list_t *dst;
+    word_count_list_t *src;
+};
+
+static void merge_task(void *arg, int worker)
+{
+    struct merge_pair *m = (struct merge_pair *)arg;
+    (void)worker;
+    merge_words(m->dst, m->src);
+}
+
+/*
+ * Tree reduction: in round r, table i with i % 2^(r+1) == 0 absorbs table
+ * i + 2^r, every pair of a round as its own task. After log2(n) rounds
+ * tables[0] holds the total.
+ */
+static void reduce(int n)
+{
+    struct merge_pair *pairs = calloc(n / 2 + 1, sizeof *pairs);
+    for (int stride = 1; stride < n; stride *= 2)
     {
-        int n = argc - 1;
-        pthread_t *tids = calloc(n, sizeof *tids);
-        struct thread_arg *args = calloc(n, sizeof *args);
-        if (!tids || !args)
+        int k = 0;
+        for (int i = 0; i + stride < n; i += 2 * stride, k++)
+        {
+            if (pairs)
+            {
+                pairs[k].dst = &tables[i];
+                pairs[k].src = &tables[i + stride];
+            }
+            if (!pairs || pool_submit(pool, -1, merge_task, &pairs[k]) != 0)
+                merge_words(&tables[i], &tables[i + stride]);
+        }
+        pool_wait(pool);
+    }
+    free(pairs);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    int first_file = parse_options(argc, argv, "a:j:k:ms:", &opts);
+    int ntables = 1;
+    void *mem;
+    if (first_file < 0)
+        return 1;
+
+    if (first_file < argc)
+    {
+        if (!(pool = pool_create(opts.jobs)))
+            return 1;
+#ifdef THREAD_LOCAL
+        ntables = pool_size(pool);
+#endif
+        if (opts.approx)
+            ntables = pool_size(pool);
+    }
+    /* The shards are cache line aligned, which calloc does not promise. */
+    if (posix_memalign(&mem, 64, ntables * sizeof *tables) != 0)
+    {
+        fprintf(stderr, "oom\n");
+        return 1;
+    }
+    tables = (word_count_list_t *)mem;
+    for (int i = 0; i < ntables; i++)
+        init_words(&tables[i]);
+    if (opts.approx)
+    {
+        sketches = (struct sketch *)calloc(ntables, sizeof *sketches);
+        if (!sketches)
         {
             fprintf(stderr, "oom\n");
             return 1;
         }
+        for (int i = 0; i < ntables; i++)
+            if (init_sketch(&sketches[i], &opts) != 0)
+                return 1;
+    }
 
-        for (int i = 0; i < n; i++)
+    if (first_file >= argc)
+    {
+        if (opts.approx)
+            sketch_count_path(&sketches[0], &tables[0], NULL, 0, -1);
+        else
+            count_words(&tables[0], stdin);
+    }
+    else
+    {
+        if (opts.inflight > 0)
         {
-            args[i].path = argv[i + 1];
-            args[i].dst = &word_counts;
-            if (pthread_create(&tids[i], NULL, worker, &args[i]) != 0)
+            reader = reader_open(&argv[first_file], argc - first_file,
+                                 opts.inflight);
+            if (!reader)
+                return 1;
+            for (int i = 0; i < pool_size(pool); i++)
             {
-                perror("pthread_create");
-                tids[i] = 0;
+                if (pool_submit(pool, i, reader_task, NULL) != 0)
+                    return 1;
             }
         }
-        for (int i = 0; i < n; i++)
+        else
         {
-            if (tids[i])
-                pthread_join(tids[i], NULL);
+            for (int i = first_file; i < argc; i++)
+            {
+                if (pool_submit(pool, -1, file_task, argv[i]) != 0)
+                    return 1;
+            }
         }
-        free(tids);
-        free(args);
+        pool_wait(pool);
+        if (reader)
+            reader_close(reader);
+#ifdef THREAD_LOCAL
+        if (!opts.approx)
+            reduce(ntables);
+#endif
+        pool_destroy(pool);
+    }
+
+    if (opts.approx)
+    {
+        for (int i = 1; i < ntables; i++)
+            sketch_merge(&sketches[0], &sketches[i]);
+        output_sketch(&sketches[0], &opts, stdout);
+        for (int i = 0; i < ntables; i++)
+            sketch_free(&sketches[i]);
+        free(sketches);
+    }
+    else
+    {
+        output_words(&tables[0], &opts, stdout);
     }
 
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
-    return 0;
+    for (int i = 0; i < ntables; i++)
+        free_words(&tables[i]);
+    free(tables);
+    return read_failed ? 1 : 0;
 }
@@ -0,0 +1,581 @@
+/*
+ * Implementation of the reader interface. Buffers cycle between a free list,
+ * the reads in flight and a queue of filled buffers, all under one mutex.
+ * Counting threads take the first queued buffer whose file nobody else is
+ * counting; since a file's buffers are queued in order, that is always the
+ * file's next one.
+ */
+
+#include "reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "word_helpers.h"
+
+#if defined(__linux__) && !defined(NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+/* Bytes requested by each read. */
+#define READ_BYTES (256 << 10)
+
+/*
+ * Room in front of each buffer for the word carried over from the file's
+ * previous buffer, so that it can be counted in place. A longer word is
+ * copied into the file's carry together with the next buffer instead.
+ */
+#define CARRY_ROOM 4096
+
+/* Buffers per read in flight: one being read, one queued or counted. */
+#define BUFFERS_PER_READ 2
+
+struct chunk {
+    struct chunk *next;
+    int file;
+    size_t len;
+    bool eof;   /* The last buffer of its file. */
+    char data[]; /* CARRY_ROOM bytes, then READ_BYTES read from the file. */
+};
+
+struct rfile {
+    const char *path;
+    int fd;
+    off_t offset;   /* Of the next read. */
+    off_t size;     /* At open. Reads of a regular file stop there. */
+    bool regular;
+    bool claimed;   /* A thread is counting a buffer of this file. */
+    char *carry;    /* Unfinished word at the end of the last buffer. */
+    size_t carry_len;
+    size_t carry_cap;
+};
+
+#ifdef HAVE_IO_URING
+/* The parts of an io_uring mapped into this process. */
+struct uring {
+    int fd;
+    void *sq_ring;
+    size_t sq_len;
+    void *cq_ring;
+    size_t cq_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+#endif
+
+struct reader {
+    struct rfile *files;
+    int nfiles;
+    int depth;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;  /* A buffer was queued, or a file released. */
+    pthread_cond_t space;  /* A buffer was freed. */
+    struct chunk *free;
+    struct chunk *head;    /* Filled buffers, oldest first. */
+    struct chunk **tail;
+    int next_file;         /* The first file not opened yet. */
+    int files_done;        /* Files counted to the end, or failed. */
+    bool error;
+    pthread_t *threads;
+    int nthreads;
+#ifdef HAVE_IO_URING
+    bool uring;
+    struct uring ring;
+#endif
+};
+
+/* Take a free buffer, waiting for one if wait. Caller holds r->lock. */
+static struct chunk *get_chunk(struct reader *r, bool wait) {
+    while (r->free == NULL && wait) {
+        pthread_cond_wait(&r->space, &r->lock);
+    }
+    struct chunk *c = r->free;
+    if (c != NULL) {
+        r->free = c->next;
+    }
+    return c;
+}
+
+/* Give up on a file that could not be opened or read. */
+static void fail_file(struct reader *r, struct rfile *f) {
+    perror(f->path);
+    pthread_mutex_lock(&r->lock);
+    r->error = true;
+    r->files_done++;
+    pthread_cond_broadcast(&r->ready);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/*
+ * Claim and open the next file not opened yet. Returns its index, or -1 if
+ * there are no more files.
+ */
+static int open_next(struct reader *r) {
+    for (;;) {
+        pthread_mutex_lock(&r->lock);
+        int i = r->next_file < r->nfiles ? r->next_file++ : -1;
+        pthread_mutex_unlock(&r->lock);
+        if (i < 0) {
+            return -1;
+        }
+
+        struct rfile *f = &r->files[i];
+        struct stat st;
+        if ((f->fd = open(f->path, O_RDONLY)) < 0) {
+            fail_file(r, f);
+            continue;
+        }
+        if (fstat(f->fd, &st) != 0) {
+            fail_file(r, f);
+            close(f->fd);
+            continue;
+        }
+        f->regular = S_ISREG(st.st_mode);
+        f->size = st.st_size;
+        f->offset = 0;
+        return i;
+    }
+}
+
+/*
+ * Queue a buffer of c->file that a read returning n (or -errno) has filled.
+ * Returns true if that was the file's last buffer.
+ */
+static bool finish_read(struct reader *r, struct chunk *c, ssize_t n) {
+    struct rfile *f = &r->files[c->file];
+    bool failed = n < 0;
+    if (failed) {
+        fprintf(stderr, "%s: %s\n", f->path, strerror(-n));
+        n = 0;
+    }
+    stats_add(STATS_BYTES, n);
+    f->offset += n;
+    c->len = n;
+    c->eof = n == 0 || (f->regular && f->offset >= f->size);
+    if (c->eof) {
+        close(f->fd);
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->error |= failed;
+    c->next = NULL;
+    *r->tail = c;
+    r->tail = &c->next;
+    pthread_cond_broadcast(&r->ready);
+    pthread_mutex_unlock(&r->lock);
+    return c->eof;
+}
+
+/* Body of a pread thread: read whole files, one buffer at a time. */
+static void *pread_thread(void *arg) {
+    struct reader *r = arg;
+    int i;
+    while ((i = open_next(r)) >= 0) {
+        struct rfile *f = &r->files[i];
+        bool eof = false;
+        while (!eof) {
+            pthread_mutex_lock(&r->lock);
+            struct chunk *c = get_chunk(r, true);
+            pthread_mutex_unlock(&r->lock);
+
+            ssize_t n;
+            char *buf = c->data + CARRY_ROOM;
+            do {
+                n = f->regular ? pread(f->fd, buf, READ_BYTES, f->offset)
+                               : read(f->fd, buf, READ_BYTES);
+            } while (n < 0 && errno == EINTR);
+            c->file = i;
+            eof = finish_read(r, c, n < 0 ? -errno : n);
+        }
+    }
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+static void uring_free(struct uring *u) {
+    if (u->sqes != NULL && u->sqes != MAP_FAILED) {
+        munmap(u->sqes, u->sqes_len);
+    }
+    if (u->cq_ring != NULL && u->cq_ring != MAP_FAILED) {
+        munmap(u->cq_ring, u->cq_len);
+    }
+    if (u->sq_ring != NULL && u->sq_ring != MAP_FAILED) {
+        munmap(u->sq_ring, u->sq_len);
+    }
+    close(u->fd);
+}
+
+/* Whether the kernel behind ring fd knows IORING_OP_READ (Linux 5.6). */
+static bool uring_can_read(int fd) {
+    size_t nops = IORING_OP_READ + 1;
+    struct io_uring_probe *probe =
+        calloc(1, sizeof *probe + nops * sizeof probe->ops[0]);
+    bool ok = probe != NULL &&
+              syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE,
+                      probe, nops) == 0 &&
+              probe->last_op >= IORING_OP_READ &&
+              (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    return ok;
+}
+
+/* Set up a ring of entries submissions. Returns 0, or -1 if unsupported. */
+static int uring_init(struct uring *u, unsigned entries) {
+    struct io_uring_params p;
+    memset(u, 0, sizeof *u);
+    memset(&p, 0, sizeof p);
+    if ((u->fd = syscall(__NR_io_uring_setup, entries, &p)) < 0) {
+        return -1;
+    }
+    u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ring = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->cq_ring = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED ||
+        u->sqes == MAP_FAILED || !uring_can_read(u->fd)) {
+        uring_free(u);
+        return -1;
+    }
+
+    char *sq = u->sq_ring;
+    char *cq = u->cq_ring;
+    u->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    u->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *) (sq + p.sq_off.array);
+    u->cq_head = (unsigned *) (cq + p.cq_off.head);
+    u->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    u->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+    return 0;
+}
+
+/* Queue a read of file i's next buffer into c, to be submitted. */
+static void uring_prep_read(struct reader *r, int i, struct chunk *c) {
+    struct uring *u = &r->ring;
+    struct rfile *f = &r->files[i];
+    unsigned tail = *u->sq_tail;
+    unsigned idx = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+
+    c->file = i;
+    memset(sqe, 0, sizeof *sqe);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = f->fd;
+    sqe->addr = (uintptr_t) (c->data + CARRY_ROOM);
+    sqe->len = READ_BYTES;
+    sqe->off = f->regular ? (uint64_t) f->offset : (uint64_t) -1;
+    sqe->user_data = (uintptr_t) c;
+    u->sq_array[idx] = idx;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Body of the io_uring thread. Keeps up to depth files with one read each in
+ * flight: as a read completes, its buffer is queued and the file's next read
+ * goes in, or the next file's first one once a file is done.
+ */
+static void *uring_thread(void *arg) {
+    struct reader *r = arg;
+    struct uring *u = &r->ring;
+    int *pending = malloc((r->depth + 1) * sizeof *pending);
+    int npending = 0; /* Open files whose next read is not in flight. */
+    int inflight = 0;
+    unsigned to_submit = 0;
+    if (pending == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    for (;;) {
+        while (inflight + (int) to_submit < r->depth) {
+            if (npending == 0) {
+                int i = open_next(r);
+                if (i < 0) {
+                    break;
+                }
+                pending[npending++] = i;
+            }
+            /* Wait for a buffer only if nothing else can wake this thread. */
+            pthread_mutex_lock(&r->lock);
+            struct chunk *c = get_chunk(r, inflight + to_submit == 0);
+            pthread_mutex_unlock(&r->lock);
+            if (c == NULL) {
+                break;
+            }
+            uring_prep_read(r, pending[--npending], c);
+            to_submit++;
+        }
+        if (inflight + to_submit == 0) {
+            break;
+        }
+
+        int n = syscall(__NR_io_uring_enter, u->fd, to_submit, 1,
+                        IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("io_uring_enter");
+            abort(); /* Reads in flight still target our buffers. */
+        }
+        inflight += n;
+        to_submit -= n;
+
+        unsigned head = *u->cq_head;
+        unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+            struct chunk *c = (struct chunk *) (uintptr_t) cqe->user_data;
+            int res = cqe->res;
+            inflight--;
+            if (res == -EINTR || res == -EAGAIN) {
+                /* Not read: put the buffer back and ask again. */
+                pending[npending++] = c->file;
+                pthread_mutex_lock(&r->lock);
+                c->next = r->free;
+                r->free = c;
+                pthread_mutex_unlock(&r->lock);
+            } else if (!finish_read(r, c, res)) {
+                pending[npending++] = c->file;
+            }
+        }
+        __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+    }
+    free(pending);
+    return NULL;
+}
+#endif
+
+/* Take the oldest queued buffer of a file no one is counting, or NULL. */
+static struct chunk *take_chunk(struct reader *r) {
+    for (struct chunk **p = &r->head; *p != NULL; p = &(*p)->next) {
+        struct chunk *c = *p;
+        if (!r->files[c->file].claimed) {
+            *p = c->next;
+            if (r->tail == &c->next) {
+                r->tail = p;
+            }
+            return c;
+        }
+    }
+    return NULL;
+}
+
+/* Append len bytes to the carry of f. Returns 0, or -1 if out of memory. */
+static int carry_append(struct rfile *f, const char *buf, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    if (f->carry_len + len > f->carry_cap) {
+        size_t cap = f->carry_cap ? f->carry_cap : CARRY_ROOM;
+        while (cap < f->carry_len + len) {
+            cap *= 2;
+        }
+        char *carry = realloc(f->carry, cap);
+        if (carry == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        f->carry = carry;
+        f->carry_cap = cap;
+    }
+    memcpy(f->carry + f->carry_len, buf, len);
+    f->carry_len += len;
+    return 0;
+}
+
+/*
+ * Count the buffer c of f, after the word carried over from f's previous
+ * buffer, and carry over the word c ends in. Returns 0, or -1 on failure.
+ */
+static int count_chunk(struct rfile *f, struct chunk *c,
+                       word_count_list_t *wclist) {
+    char *p = c->data + CARRY_ROOM;
+    size_t len = c->len;
+    if (f->carry_len > CARRY_ROOM) {
+        if (carry_append(f, p, len) != 0) {
+            return -1;
+        }
+        p = f->carry;
+        len = f->carry_len;
+    } else if (f->carry_len > 0) {
+        p -= f->carry_len;
+        memcpy(p, f->carry, f->carry_len);
+        len += f->carry_len;
+    }
+    f->carry_len = 0;
+
+    ssize_t used = count_words_chunk(wclist, p, len, c->eof);
+    int rv = 0;
+    if (used < 0) {
+        rv = -1;
+    } else if (p == f->carry) {
+        memmove(f->carry, p + used, len - used);
+        f->carry_len = len - used;
+    } else {
+        rv = carry_append(f, p + used, len - used);
+    }
+    if (c->eof) {
+        free(f->carry);
+        f->carry = NULL;
+        f->carry_len = 0;
+        f->carry_cap = 0;
+    }
+    return rv;
+}
+
+int reader_count(struct reader *r, word_count_list_t *wclist) {
+    int rv = 0;
+    pthread_mutex_lock(&r->lock);
+    while (r->files_done < r->nfiles) {
+        struct chunk *c = take_chunk(r);
+        if (c == NULL) {
+            /* Counting stalls on input: charge the wait to reading. */
+            uint64_t start = stats_begin();
+            pthread_cond_wait(&r->ready, &r->lock);
+            stats_end(STATS_READ, start);
+            continue;
+        }
+        struct rfile *f = &r->files[c->file];
+        f->claimed = true;
+        pthread_mutex_unlock(&r->lock);
+
+        if (count_chunk(f, c, wclist) != 0) {
+            rv = -1;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        f->claimed = false;
+        if (c->eof) {
+            r->files_done++;
+        }
+        c->next = r->free;
+        r->free = c;
+        pthread_cond_signal(&r->space);
+        pthread_cond_broadcast(&r->ready);
+    }
+    if (r->error) {
+        rv = -1;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return rv;
+}
+
+struct reader *reader_open(char *paths[], int n, int depth) {
+    if (depth < 1 || depth > READER_MAX_DEPTH) {
+        fprintf(stderr, "reader: depth must be 1 to %d\n", READER_MAX_DEPTH);
+        return NULL;
+    }
+    struct reader *r = calloc(1, sizeof *r);
+    if (r == NULL || (r->files = calloc(n + 1, sizeof *r->files)) == NULL ||
+        (r->threads = calloc(depth, sizeof *r->threads)) == NULL) {
+        fprintf(stderr, "oom\n");
+        reader_close(r);
+        return NULL;
+    }
+    for (int i = 0; i < n; i++) {
+        r->files[i].path = paths[i];
+        r->files[i].fd = -1;
+    }
+    r->nfiles = n;
+    r->depth = depth;
+    r->tail = &r->head;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->ready, NULL);
+    pthread_cond_init(&r->space, NULL);
+    for (int i = 0; i < BUFFERS_PER_READ * depth; i++) {
+        struct chunk *c = malloc(sizeof *c + CARRY_ROOM + READ_BYTES);
+        if (c == NULL) {
+            fprintf(stderr, "oom\n");
+            reader_close(r);
+            return NULL;
+        }
+        c->next = r->free;
+        r->free = c;
+    }
+
+    void *(*body)(void *) = pread_thread;
+    int nthreads = depth;
+#ifdef HAVE_IO_URING
+    if (uring_init(&r->ring, depth) == 0) {
+        r->uring = true;
+        body = uring_thread;
+        nthreads = 1;
+    }
+#endif
+    for (int i = 0; i < nthreads; i++) {
+        int err = pthread_create(&r->threads[i], NULL, body, r);
+        if (err != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(err));
+            break;
+        }
+        r->nthreads++;
+    }
+    if (r->nthreads == 0) {
+        reader_close(r);
+        return NULL;
+    }
+    return r;
+}
+
+void reader_close(struct reader *r) {
+    if (r == NULL) {
+        return;
+    }
+    for (int i = 0; i < r->nthreads; i++) {
+        pthread_join(r->threads[i], NULL);
+    }
+#ifdef HAVE_IO_URING
+    if (r->uring) {
+        uring_free(&r->ring);
+    }
+#endif
+    if (r->tail != NULL) {
+        pthread_mutex_destroy(&r->lock);
+        pthread_cond_destroy(&r->ready);
+        pthread_cond_destroy(&r->space);
+    }
+    while (r->free != NULL) {
+        struct chunk *c = r->free;
+        r->free = c->next;
+        free(c);
+    }
+    while (r->head != NULL) {
+        struct chunk *c = r->head;
+        r->head = c->next;
+        free(c);
+    }
+    for (int i = 0; r->files != NULL && i < r->nfiles; i++) {
+        free(r->files[i].carry);
+    }
+    free(r->files);
+    free(r->threads);
+    free(r);
+}
@@ -0,0 +1,50 @@
+/*
+ * The reader interface is an asynchronous ingestion stage for counting many
+ * files. It keeps up to depth reads in flight, each into a buffer of its own,
+ * and queues the filled buffers for any number of counting threads, so that
+ * reading the next files overlaps with counting the current ones instead of
+ * alternating with it.
+ *
+ * Reads go through io_uring where the kernel offers it (Linux 5.6 and up),
+ * issued from one submitting thread without liburing. Elsewhere, or if the
+ * ring cannot be set up, depth threads read with pread(2). Either way at most
+ * one read per file is outstanding, so a file's buffers arrive in order, and
+ * a file's buffers are counted by one thread at a time, in order, carrying a
+ * word cut by the end of one buffer over to the next. The number of buffers
+ * is bounded, so reading never runs far ahead of counting.
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include "word_count.h"
+
+struct reader;
+
+/*
+ * The most reads reader_open keeps in flight. Each costs two buffers of a
+ * little over 256 KiB and, without io_uring, a thread.
+ */
+#define READER_MAX_DEPTH 256
+
+/*
+ * Starts reading the n files in paths, keeping up to depth reads in flight,
+ * 1 <= depth <= READER_MAX_DEPTH. Returns NULL (after printing an error) if
+ * the reader cannot be set up.
+ */
+struct reader *reader_open(char *paths[], int n, int depth);
+
+/*
+ * Counts buffers from r into wclist until every file has been counted. May
+ * be called from several threads at once, with shared or separate tables.
+ * Returns 0, or -1 if any file could not be read or counted.
+ */
+int reader_count(struct reader *r, word_count_list_t *wclist);
+
+/*
+ * Waits for the reading threads and frees the reader. Call it once every
+ * reader_count call has returned.
+ */
+void reader_close(struct reader *r);
+
+#endif /* READER_H */
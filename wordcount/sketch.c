@@ -0,0 +1,491 @@
+/*
+ * Implementation of the sketch interface.
+ *
+ * The candidates are a Space-Saving list whose counts are the sketch's
+ * estimates: a word not yet listed replaces the candidate with the lowest
+ * estimate once its own estimate is higher. A hash table finds a word's
+ * candidate and a min-heap finds the one to replace, so every update costs
+ * depth counter bumps plus O(log capacity).
+ */
+
+#include "sketch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "word_count.h"
+#include "word_helpers.h"
+#include "word_io.h"
+
+/* Bytes read per call in sketch_count_path. */
+#define SKETCH_READ_CHUNK 65536
+
+/* Input bytes counted into the scratch list between folds into the sketch. */
+#define SKETCH_FLUSH_BYTES (4 << 20)
+
+/* Header of a sketch written by sketch_write. */
+struct sketch_header {
+    uint32_t width;
+    uint32_t depth;
+    uint32_t nitems;
+    uint32_t unused;
+    uint64_t total;
+};
+
+/* 64-bit FNV-1a, finished with a mixer so that both halves are usable. */
+static uint64_t hash_word64(const char *word) {
+    uint64_t h = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *) word; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+/* Counter of row i for hash h: double hashing with the two halves of h. */
+static uint32_t *cell(const struct sketch *sk, uint64_t h, uint32_t i) {
+    uint64_t h1 = h & 0xffffffff;
+    uint64_t h2 = (h >> 32) | 1;
+    return &sk->cells[(size_t) i * sk->width + (h1 + i * h2) % sk->width];
+}
+
+static uint32_t add_saturating(uint32_t a, uint32_t b) {
+    return a > UINT32_MAX - b ? UINT32_MAX : a + b;
+}
+
+static uint32_t estimate_hash(const struct sketch *sk, uint64_t h) {
+    uint32_t est = UINT32_MAX;
+    for (uint32_t i = 0; i < sk->depth; i++) {
+        uint32_t c = *cell(sk, h, i);
+        if (c < est) {
+            est = c;
+        }
+    }
+    return est;
+}
+
+static void heap_swap(struct sketch *sk, uint32_t a, uint32_t b) {
+    uint32_t t = sk->heap[a];
+    sk->heap[a] = sk->heap[b];
+    sk->heap[b] = t;
+    sk->items[sk->heap[a]].heap = a;
+    sk->items[sk->heap[b]].heap = b;
+}
+
+static uint32_t heap_count(const struct sketch *sk, uint32_t pos) {
+    return sk->items[sk->heap[pos]].count;
+}
+
+static void heap_up(struct sketch *sk, uint32_t pos) {
+    while (pos > 0 && heap_count(sk, pos) < heap_count(sk, (pos - 1) / 2)) {
+        heap_swap(sk, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+}
+
+static void heap_down(struct sketch *sk, uint32_t pos) {
+    for (;;) {
+        uint32_t min = pos;
+        uint32_t l = 2 * pos + 1;
+        uint32_t r = l + 1;
+        if (l < sk->nitems && heap_count(sk, l) < heap_count(sk, min)) {
+            min = l;
+        }
+        if (r < sk->nitems && heap_count(sk, r) < heap_count(sk, min)) {
+            min = r;
+        }
+        if (min == pos) {
+            return;
+        }
+        heap_swap(sk, pos, min);
+        pos = min;
+    }
+}
+
+static int32_t *chain_head(const struct sketch *sk, uint64_t h) {
+    return &sk->buckets[h & (sk->nbuckets - 1)];
+}
+
+static int32_t find_item(const struct sketch *sk, const char *word,
+                         uint64_t h) {
+    for (int32_t i = *chain_head(sk, h); i >= 0; i = sk->items[i].next) {
+        if (sk->items[i].hash == h && strcmp(sk->items[i].word, word) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void unlink_item(struct sketch *sk, int32_t idx) {
+    int32_t *p = chain_head(sk, sk->items[idx].hash);
+    while (*p != idx) {
+        p = &sk->items[*p].next;
+    }
+    *p = sk->items[idx].next;
+}
+
+static void link_item(struct sketch *sk, int32_t idx) {
+    int32_t *head = chain_head(sk, sk->items[idx].hash);
+    sk->items[idx].next = *head;
+    *head = idx;
+}
+
+/*
+ * Space-Saving update: raise word's candidate to est, list it if there is
+ * room, or let it replace the lowest candidate if est beats that.
+ */
+static void offer(struct sketch *sk, const char *word, uint64_t h,
+                  uint32_t est) {
+    int32_t idx = find_item(sk, word, h);
+    if (idx >= 0) {
+        sk->items[idx].count = est; /* Estimates never go down. */
+        heap_down(sk, sk->items[idx].heap);
+        return;
+    }
+    if (sk->capacity == 0) {
+        return;
+    }
+
+    bool room = sk->nitems < sk->capacity;
+    if (!room && est <= heap_count(sk, 0)) {
+        return;
+    }
+    char *copy = strdup(word);
+    if (copy == NULL) {
+        return;
+    }
+    if (room) {
+        idx = sk->nitems;
+        sk->heap[sk->nitems] = idx;
+        sk->items[idx].heap = sk->nitems++;
+    } else {
+        idx = sk->heap[0];
+        unlink_item(sk, idx);
+        free(sk->items[idx].word);
+    }
+    sk->items[idx].word = copy;
+    sk->items[idx].hash = h;
+    sk->items[idx].count = est;
+    link_item(sk, idx);
+    if (room) {
+        heap_up(sk, sk->items[idx].heap);
+    } else {
+        heap_down(sk, 0);
+    }
+}
+
+int sketch_init(struct sketch *sk, double epsilon, double delta,
+                uint32_t capacity) {
+    memset(sk, 0, sizeof *sk);
+    sk->width = ceil(exp(1.0) / epsilon);
+    sk->depth = ceil(log(1.0 / delta));
+    if (sk->depth < 1) {
+        sk->depth = 1;
+    }
+    sk->capacity = capacity;
+    sk->nbuckets = 1;
+    while (sk->nbuckets < 2 * capacity) {
+        sk->nbuckets *= 2;
+    }
+    sk->cells = calloc((size_t) sk->width * sk->depth, sizeof *sk->cells);
+    sk->items = calloc(capacity + 1, sizeof *sk->items);
+    sk->heap = calloc(capacity + 1, sizeof *sk->heap);
+    sk->buckets = malloc(sk->nbuckets * sizeof *sk->buckets);
+    if (!sk->cells || !sk->items || !sk->heap || !sk->buckets) {
+        fprintf(stderr, "oom\n");
+        sketch_free(sk);
+        return -1;
+    }
+    memset(sk->buckets, 0xff, sk->nbuckets * sizeof *sk->buckets);
+    return 0;
+}
+
+void sketch_free(struct sketch *sk) {
+    for (uint32_t i = 0; i < sk->nitems; i++) {
+        free(sk->items[i].word);
+    }
+    free(sk->cells);
+    free(sk->items);
+    free(sk->heap);
+    free(sk->buckets);
+    memset(sk, 0, sizeof *sk);
+}
+
+void sketch_add(struct sketch *sk, const char *word, uint32_t count) {
+    uint64_t h = hash_word64(word);
+    uint32_t est = UINT32_MAX;
+    for (uint32_t i = 0; i < sk->depth; i++) {
+        uint32_t *c = cell(sk, h, i);
+        *c = add_saturating(*c, count);
+        if (*c < est) {
+            est = *c;
+        }
+    }
+    sk->total += count;
+    offer(sk, word, h, est);
+}
+
+uint32_t sketch_estimate(const struct sketch *sk, const char *word) {
+    return estimate_hash(sk, hash_word64(word));
+}
+
+/*
+ * First half of a merge: add counters and bring the estimates of dst's own
+ * candidates up to date. The other sketch's candidates are offered next.
+ */
+static void merge_cells(struct sketch *dst, const uint32_t *cells,
+                        uint64_t total) {
+    size_t n = (size_t) dst->width * dst->depth;
+    for (size_t i = 0; i < n; i++) {
+        dst->cells[i] = add_saturating(dst->cells[i], cells[i]);
+    }
+    dst->total += total;
+    for (uint32_t i = 0; i < dst->nitems; i++) {
+        dst->items[i].count = estimate_hash(dst, dst->items[i].hash);
+    }
+    for (uint32_t i = dst->nitems / 2; i-- > 0;) {
+        heap_down(dst, i);
+    }
+}
+
+int sketch_merge(struct sketch *dst, const struct sketch *src) {
+    if (dst->width != src->width || dst->depth != src->depth) {
+        fprintf(stderr, "cannot merge sketches of different sizes\n");
+        return -1;
+    }
+    uint64_t start = stats_begin();
+    merge_cells(dst, src->cells, src->total);
+    for (uint32_t i = 0; i < src->nitems; i++) {
+        const struct sketch_item *it = &src->items[i];
+        offer(dst, it->word, it->hash, estimate_hash(dst, it->hash));
+    }
+    stats_end(STATS_MERGE, start);
+    return 0;
+}
+
+/* Add the counts in scratch to sk and empty scratch. */
+static void fold_entry(word_count_t *wc, void *aux) {
+    sketch_add(aux, wc->word, wc->count);
+}
+
+static void fold_scratch(struct sketch *sk, word_count_list_t *scratch) {
+    uint64_t start = stats_begin();
+    wordcount_foreach(scratch, fold_entry, sk);
+    stats_end(STATS_COUNT, start);
+    free_words(scratch);
+    init_words(scratch);
+}
+
+int sketch_count_path(struct sketch *sk, word_count_list_t *scratch,
+                      const char *path, off_t start, off_t len) {
+    const char *name = path ? path : "stdin";
+    int fd = path ? open(path, O_RDONLY) : STDIN_FILENO;
+    if (fd < 0 || (start > 0 && lseek(fd, start, SEEK_SET) < 0)) {
+        perror(name);
+        if (fd >= 0 && path) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    size_t cap = SKETCH_READ_CHUNK;
+    size_t keep = 0;
+    size_t pending = 0;
+    char *buf = malloc(cap);
+    int rv = 0;
+    if (buf == NULL) {
+        perror("malloc");
+        rv = -1;
+    }
+    while (buf != NULL) {
+        size_t want = cap - keep;
+        if (len >= 0 && (off_t) want > len) {
+            want = len;
+        }
+        uint64_t t = stats_begin();
+        ssize_t n = want > 0 ? read(fd, buf + keep, want) : 0;
+        stats_end(STATS_READ, t);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror(name);
+            rv = -1;
+            break;
+        }
+        stats_add(STATS_BYTES, n);
+        if (len >= 0) {
+            len -= n;
+        }
+        size_t avail = keep + n;
+        ssize_t used = count_words_chunk(scratch, buf, avail, n == 0);
+        if (used < 0) {
+            rv = -1;
+            break;
+        }
+        pending += n;
+        if (pending >= SKETCH_FLUSH_BYTES) {
+            fold_scratch(sk, scratch);
+            pending = 0;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        /* Carry a word cut by the end of the chunk over to the next read. */
+        keep = avail - used;
+        memmove(buf, buf + used, keep);
+        if (keep == cap) {
+            char *new_buf = realloc(buf, cap * 2);
+            if (new_buf == NULL) {
+                perror("realloc");
+                rv = -1;
+                break;
+            }
+            buf = new_buf;
+            cap *= 2;
+        }
+    }
+    fold_scratch(sk, scratch);
+    free(buf);
+    if (path) {
+        close(fd);
+    }
+    return rv;
+}
+
+/* Orders items like less_count: by estimate, then by word. */
+static int compare_items(const void *a, const void *b) {
+    const struct sketch_item *ia = *(const struct sketch_item *const *) a;
+    const struct sketch_item *ib = *(const struct sketch_item *const *) b;
+    if (ia->count != ib->count) {
+        return ia->count < ib->count ? -1 : 1;
+    }
+    return strcmp(ia->word, ib->word);
+}
+
+void sketch_print(const struct sketch *sk, size_t k, FILE *outfile) {
+    const struct sketch_item **order = malloc((sk->nitems + 1) * sizeof *order);
+    struct word_writer *w;
+    if (order == NULL) {
+        perror("malloc");
+        return;
+    }
+    if ((w = word_writer_open(outfile)) == NULL) {
+        free(order);
+        return;
+    }
+    for (uint32_t i = 0; i < sk->nitems; i++) {
+        order[i] = &sk->items[i];
+    }
+    qsort(order, sk->nitems, sizeof *order, compare_items);
+    size_t first = sk->nitems > k ? sk->nitems - k : 0;
+    for (size_t i = first; i < sk->nitems; i++) {
+        int count = order[i]->count > INT32_MAX ? INT32_MAX : order[i]->count;
+        word_writer_put_text(w, count, order[i]->word);
+    }
+    word_writer_close(w);
+    free(order);
+}
+
+int sketch_write(const struct sketch *sk, int fd) {
+    struct sketch_header hdr = {sk->width, sk->depth, sk->nitems, 0,
+                                sk->total};
+    struct word_writer *w = malloc(sizeof *w);
+    if (w == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    word_writer_init(w, fd);
+    word_writer_put_bytes(w, &hdr, sizeof hdr);
+    word_writer_put_bytes(w, sk->cells,
+                          (size_t) sk->width * sk->depth * sizeof *sk->cells);
+    for (uint32_t i = 0; i < sk->nitems; i++) {
+        word_writer_put_frame(w, sk->items[i].count, sk->items[i].word);
+    }
+    int rv = word_writer_flush(w);
+    if (rv != 0) {
+        errno = w->error;
+        perror("write sketch");
+    }
+    free(w);
+    return rv;
+}
+
+/* Read exactly len bytes. Returns 0, or -1 on error or early end of file. */
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int sketch_read_merge(struct sketch *sk, int fd) {
+    struct sketch_header hdr;
+    if (read_full(fd, &hdr, sizeof hdr) != 0) {
+        fprintf(stderr, "could not read sketch\n");
+        return -1;
+    }
+    if (hdr.width != sk->width || hdr.depth != sk->depth) {
+        fprintf(stderr, "cannot merge sketches of different sizes\n");
+        return -1;
+    }
+    size_t n = (size_t) hdr.width * hdr.depth;
+    uint32_t *cells = malloc(n * sizeof *cells);
+    if (cells == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    if (read_full(fd, cells, n * sizeof *cells) != 0) {
+        fprintf(stderr, "could not read sketch\n");
+        free(cells);
+        return -1;
+    }
+    uint64_t start = stats_begin();
+    merge_cells(sk, cells, hdr.total);
+    stats_end(STATS_MERGE, start);
+    free(cells);
+
+    int rv = 0;
+    char *word = NULL;
+    for (uint32_t i = 0; i < hdr.nitems && rv == 0; i++) {
+        struct word_frame f;
+        char *new_word;
+        if (read_full(fd, &f, sizeof f) != 0 ||
+            (new_word = realloc(word, (size_t) f.len + 1)) == NULL) {
+            rv = -1;
+            break;
+        }
+        word = new_word;
+        if (read_full(fd, word, f.len) != 0) {
+            rv = -1;
+            break;
+        }
+        word[f.len] = '\0';
+        uint64_t h = hash_word64(word);
+        offer(sk, word, h, estimate_hash(sk, h));
+    }
+    if (rv != 0) {
+        fprintf(stderr, "could not read sketch\n");
+    }
+    free(word);
+    return rv;
+}
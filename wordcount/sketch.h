@@ -0,0 +1,106 @@
+/*
+ * The sketch interface counts words approximately in fixed memory, for the
+ * --approx mode of the word count tools. A Count-Min Sketch of depth rows of
+ * width counters estimates the count of any word, never too low and too high
+ * by at most epsilon times the total with probability 1 - delta, where width
+ * is e / epsilon and depth is ln(1 / delta). Next to it, a Space-Saving list
+ * of candidates keeps the words with the highest estimates seen so far, which
+ * are the heavy hitters that get printed.
+ *
+ * Sketches with the same epsilon and delta merge by adding their counters, so
+ * each thread or process can keep its own and they are summed at the end.
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "word_count.h"
+
+/* Defaults for --epsilon and --delta. */
+#define SKETCH_EPSILON 0.0001
+#define SKETCH_DELTA 0.01
+
+/* Heavy hitters printed when -k is not given. */
+#define SKETCH_DEFAULT_TOP 100
+
+/* Candidates kept for each heavy hitter to be printed. */
+#define SKETCH_CANDIDATES_PER_TOP 4
+
+struct sketch_item {
+    char *word;
+    uint64_t hash;
+    uint32_t count; /* Estimate of the count of word. */
+    int32_t next;   /* Next item in the same hash chain, or -1. */
+    uint32_t heap;  /* Position in the heap. */
+};
+
+struct sketch {
+    uint32_t width;
+    uint32_t depth;
+    uint32_t *cells;            /* depth rows of width counters. */
+    uint64_t total;             /* Sum of all counts added. */
+    struct sketch_item *items;  /* Candidates. */
+    uint32_t nitems;
+    uint32_t capacity;
+    uint32_t *heap;             /* Items by ascending count. */
+    int32_t *buckets;           /* Heads of item hash chains, or -1. */
+    uint32_t nbuckets;          /* A power of two. */
+};
+
+/*
+ * Initializes an empty sketch with the given error bounds, keeping at most
+ * capacity candidates. Returns 0, or -1 (after printing an error) if out of
+ * memory.
+ */
+int sketch_init(struct sketch *sk, double epsilon, double delta,
+                uint32_t capacity);
+
+/* Releases the memory of a sketch. */
+void sketch_free(struct sketch *sk);
+
+/* Adds count occurrences of word. */
+void sketch_add(struct sketch *sk, const char *word, uint32_t count);
+
+/* Returns the estimated count of word. */
+uint32_t sketch_estimate(const struct sketch *sk, const char *word);
+
+/*
+ * Adds src into dst. Both must have been initialized with the same epsilon
+ * and delta. Returns 0, or -1 if they do not match.
+ */
+int sketch_merge(struct sketch *dst, const struct sketch *src);
+
+/*
+ * Counts the words of the file at path, or of stdin if path is NULL, into
+ * sk. Only the len bytes from offset start are read; a negative len means to
+ * the end. The words of each few megabytes of input are counted exactly into
+ * scratch, an empty list owned by the caller, and then folded into sk, so
+ * scratch stays small however large the input is. Returns 0 on success, -1
+ * (after printing an error) on failure.
+ */
+int sketch_count_path(struct sketch *sk, word_count_list_t *scratch,
+                      const char *path, off_t start, off_t len);
+
+/*
+ * Prints the k candidates with the highest estimates in the format and order
+ * of output_words.
+ */
+void sketch_print(const struct sketch *sk, size_t k, FILE *outfile);
+
+/*
+ * Writes sk to fd, to be merged into another sketch by sketch_read_merge.
+ * Returns 0, or -1 (after printing an error) on failure.
+ */
+int sketch_write(const struct sketch *sk, int fd);
+
+/*
+ * Reads a sketch written by sketch_write from fd and merges it into sk.
+ * Returns 0, or -1 (after printing an error) on failure.
+ */
+int sketch_read_merge(struct sketch *sk, int fd);
+
+#endif /* SKETCH_H */
@@ -0,0 +1,110 @@
+/*
+ * Implementation of the stats interface. A thread's block is allocated the
+ * first time it records and linked onto a global list, which stats_print
+ * walks. Blocks live until the process exits.
+ */
+
+#include "stats.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct stats_block {
+    uint64_t phases[STATS_NPHASES];
+    uint64_t counters[STATS_NCOUNTERS];
+    struct stats_block *next;
+} __attribute__((aligned(64)));
+
+bool stats_enabled;
+
+static const char *stats_prog;
+static uint64_t stats_start;
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct stats_block *blocks;
+static __thread struct stats_block *mine;
+
+static const char *const phase_names[STATS_NPHASES] = {
+    "read", "count", "merge", "sort", "output",
+};
+
+uint64_t stats_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* This thread's block, or NULL if it cannot be allocated. */
+static struct stats_block *my_block(void) {
+    if (mine == NULL && (mine = calloc(1, sizeof *mine)) != NULL) {
+        pthread_mutex_lock(&blocks_lock);
+        mine->next = blocks;
+        blocks = mine;
+        pthread_mutex_unlock(&blocks_lock);
+    }
+    return mine;
+}
+
+void stats_record(enum stats_counter c, uint64_t n) {
+    struct stats_block *b = my_block();
+    if (b != NULL) {
+        b->counters[c] += n;
+    }
+}
+
+void stats_record_phase(enum stats_phase p, uint64_t ns) {
+    struct stats_block *b = my_block();
+    if (b != NULL) {
+        b->phases[p] += ns;
+    }
+}
+
+static void print_at_exit(void) {
+    stats_print();
+}
+
+void stats_enable(const char *prog) {
+    if (stats_enabled) {
+        return;
+    }
+    stats_prog = prog;
+    stats_start = stats_clock();
+    stats_enabled = true;
+    atexit(print_at_exit);
+}
+
+void stats_print(void) {
+    struct stats_block sum = {{0}, {0}, NULL};
+    double wall = (stats_clock() - stats_start) / 1e9;
+
+    pthread_mutex_lock(&blocks_lock);
+    for (struct stats_block *b = blocks; b != NULL; b = b->next) {
+        for (int i = 0; i < STATS_NPHASES; i++) {
+            sum.phases[i] += b->phases[i];
+        }
+        for (int i = 0; i < STATS_NCOUNTERS; i++) {
+            sum.counters[i] += b->counters[i];
+        }
+    }
+    pthread_mutex_unlock(&blocks_lock);
+
+    const uint64_t *c = sum.counters;
+    fprintf(stderr, "%s[%d] stats:\n", stats_prog, (int) getpid());
+    fprintf(stderr, "  %-12s %10.3f s\n", "wall", wall);
+    for (int i = 0; i < STATS_NPHASES; i++) {
+        fprintf(stderr, "  %-12s %10.3f s\n", phase_names[i],
+                sum.phases[i] / 1e9);
+    }
+    fprintf(stderr, "  %-12s %10llu\n", "bytes",
+            (unsigned long long) c[STATS_BYTES]);
+    fprintf(stderr, "  %-12s %10llu\n", "tokens",
+            (unsigned long long) c[STATS_TOKENS]);
+    fprintf(stderr, "  %-12s %10llu (%llu waited, %.3f s)\n", "locks",
+            (unsigned long long) c[STATS_LOCKS],
+            (unsigned long long) c[STATS_LOCK_WAITS],
+            c[STATS_LOCK_WAIT_NS] / 1e9);
+    fprintf(stderr, "  %-12s %10llu\n", "grows",
+            (unsigned long long) c[STATS_GROWS]);
+}
@@ -0,0 +1,76 @@
+/*
+ * The stats interface collects the --stats profile of the word count tools:
+ * the time spent in each phase of a run and counters for the events behind
+ * it. Every thread records into a block of its own, so recording takes no
+ * lock and shares no cache line with other threads; stats_print adds the
+ * blocks up. While stats_enabled is false, each hook below is one test of a
+ * global flag and records nothing.
+ *
+ * Phase times are summed over threads, so with several threads they can add
+ * up to more than the wall clock time.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+enum stats_phase {
+    STATS_READ,   /* read(2) and fread of the input. */
+    STATS_COUNT,  /* Tokenizing and adding words to the tables. */
+    STATS_MERGE,  /* Combining tables, sketches or worker output. */
+    STATS_SORT,   /* Ordering the words to print. */
+    STATS_OUTPUT, /* Formatting and writing them. */
+    STATS_NPHASES
+};
+
+enum stats_counter {
+    STATS_BYTES,      /* Input bytes read or mapped. */
+    STATS_TOKENS,     /* Words counted (after dropping short ones). */
+    STATS_LOCKS,      /* Shard lock acquisitions in word_count_p.c. */
+    STATS_LOCK_WAITS, /* Acquisitions that found the lock taken. */
+    STATS_LOCK_WAIT_NS, /* Time spent waiting in those. */
+    STATS_GROWS,      /* Hash table resizes. */
+    STATS_NCOUNTERS
+};
+
+/* Set by stats_enable. */
+extern bool stats_enabled;
+
+/*
+ * Turns recording on, starts the wall clock and arranges for stats_print to
+ * run at exit. prog names the tool in the summary.
+ */
+void stats_enable(const char *prog);
+
+/* Prints the summary of this process to stderr. */
+void stats_print(void);
+
+/* A monotonic clock in nanoseconds. */
+uint64_t stats_clock(void);
+
+/* Out of line halves of the hooks below. */
+void stats_record(enum stats_counter c, uint64_t n);
+void stats_record_phase(enum stats_phase p, uint64_t ns);
+
+/* Start timing a phase; pass the result to stats_end. */
+static inline uint64_t stats_begin(void) {
+    return stats_enabled ? stats_clock() : 0;
+}
+
+/* Add the time since start, from stats_begin, to phase p. */
+static inline void stats_end(enum stats_phase p, uint64_t start) {
+    if (stats_enabled) {
+        stats_record_phase(p, stats_clock() - start);
+    }
+}
+
+/* Add n to counter c. */
+static inline void stats_add(enum stats_counter c, uint64_t n) {
+    if (stats_enabled) {
+        stats_record(c, n);
+    }
+}
+
+#endif /* STATS_H */
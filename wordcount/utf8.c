@@ -0,0 +1,651 @@
+/*
+ * Implementation of the utf8 interface. Code points below U+0800, which
+ * cover Latin, Greek, Cyrillic, Armenian, Hebrew and Arabic, are looked up
+ * directly in fold2; the rest are found by binary search in range tables.
+ * The tables were generated from the Unicode 14.0 character database: a
+ * code point folds to the single character of its full case folding, or
+ * else to its simple lower case mapping (UnicodeData.txt), so that U+0130
+ * folds to "i" even though both its full mappings are two characters.
+ */
+
+#include "utf8.h"
+
+struct cp_range {
+    uint32_t lo;
+    uint32_t hi;
+};
+
+struct fold_range {
+    struct cp_range range; /* First, so find_range can search folds. */
+    int32_t delta;
+    uint32_t stride;
+};
+
+/* Folded code point of each of U+0080..U+07FF, or 0 if not a letter. */
+static const uint16_t fold2[0x800 - 0x80] = {
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x00aa, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x03bc, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x00ba, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+    0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+    0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x0000,
+    0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00df,
+    0x00e0, 0x00e1, 0x00e2, 0x00e3, 0x00e4, 0x00e5, 0x00e6, 0x00e7,
+    0x00e8, 0x00e9, 0x00ea, 0x00eb, 0x00ec, 0x00ed, 0x00ee, 0x00ef,
+    0x00f0, 0x00f1, 0x00f2, 0x00f3, 0x00f4, 0x00f5, 0x00f6, 0x0000,
+    0x00f8, 0x00f9, 0x00fa, 0x00fb, 0x00fc, 0x00fd, 0x00fe, 0x00ff,
+    0x0101, 0x0101, 0x0103, 0x0103, 0x0105, 0x0105, 0x0107, 0x0107,
+    0x0109, 0x0109, 0x010b, 0x010b, 0x010d, 0x010d, 0x010f, 0x010f,
+    0x0111, 0x0111, 0x0113, 0x0113, 0x0115, 0x0115, 0x0117, 0x0117,
+    0x0119, 0x0119, 0x011b, 0x011b, 0x011d, 0x011d, 0x011f, 0x011f,
+    0x0121, 0x0121, 0x0123, 0x0123, 0x0125, 0x0125, 0x0127, 0x0127,
+    0x0129, 0x0129, 0x012b, 0x012b, 0x012d, 0x012d, 0x012f, 0x012f,
+    0x0069, 0x0131, 0x0133, 0x0133, 0x0135, 0x0135, 0x0137, 0x0137,
+    0x0138, 0x013a, 0x013a, 0x013c, 0x013c, 0x013e, 0x013e, 0x0140,
+    0x0140, 0x0142, 0x0142, 0x0144, 0x0144, 0x0146, 0x0146, 0x0148,
+    0x0148, 0x0149, 0x014b, 0x014b, 0x014d, 0x014d, 0x014f, 0x014f,
+    0x0151, 0x0151, 0x0153, 0x0153, 0x0155, 0x0155, 0x0157, 0x0157,
+    0x0159, 0x0159, 0x015b, 0x015b, 0x015d, 0x015d, 0x015f, 0x015f,
+    0x0161, 0x0161, 0x0163, 0x0163, 0x0165, 0x0165, 0x0167, 0x0167,
+    0x0169, 0x0169, 0x016b, 0x016b, 0x016d, 0x016d, 0x016f, 0x016f,
+    0x0171, 0x0171, 0x0173, 0x0173, 0x0175, 0x0175, 0x0177, 0x0177,
+    0x00ff, 0x017a, 0x017a, 0x017c, 0x017c, 0x017e, 0x017e, 0x0073,
+    0x0180, 0x0253, 0x0183, 0x0183, 0x0185, 0x0185, 0x0254, 0x0188,
+    0x0188, 0x0256, 0x0257, 0x018c, 0x018c, 0x018d, 0x01dd, 0x0259,
+    0x025b, 0x0192, 0x0192, 0x0260, 0x0263, 0x0195, 0x0269, 0x0268,
+    0x0199, 0x0199, 0x019a, 0x019b, 0x026f, 0x0272, 0x019e, 0x0275,
+    0x01a1, 0x01a1, 0x01a3, 0x01a3, 0x01a5, 0x01a5, 0x0280, 0x01a8,
+    0x01a8, 0x0283, 0x01aa, 0x01ab, 0x01ad, 0x01ad, 0x0288, 0x01b0,
+    0x01b0, 0x028a, 0x028b, 0x01b4, 0x01b4, 0x01b6, 0x01b6, 0x0292,
+    0x01b9, 0x01b9, 0x01ba, 0x01bb, 0x01bd, 0x01bd, 0x01be, 0x01bf,
+    0x01c0, 0x01c1, 0x01c2, 0x01c3, 0x01c6, 0x01c6, 0x01c6, 0x01c9,
+    0x01c9, 0x01c9, 0x01cc, 0x01cc, 0x01cc, 0x01ce, 0x01ce, 0x01d0,
+    0x01d0, 0x01d2, 0x01d2, 0x01d4, 0x01d4, 0x01d6, 0x01d6, 0x01d8,
+    0x01d8, 0x01da, 0x01da, 0x01dc, 0x01dc, 0x01dd, 0x01df, 0x01df,
+    0x01e1, 0x01e1, 0x01e3, 0x01e3, 0x01e5, 0x01e5, 0x01e7, 0x01e7,
+    0x01e9, 0x01e9, 0x01eb, 0x01eb, 0x01ed, 0x01ed, 0x01ef, 0x01ef,
+    0x01f0, 0x01f3, 0x01f3, 0x01f3, 0x01f5, 0x01f5, 0x0195, 0x01bf,
+    0x01f9, 0x01f9, 0x01fb, 0x01fb, 0x01fd, 0x01fd, 0x01ff, 0x01ff,
+    0x0201, 0x0201, 0x0203, 0x0203, 0x0205, 0x0205, 0x0207, 0x0207,
+    0x0209, 0x0209, 0x020b, 0x020b, 0x020d, 0x020d, 0x020f, 0x020f,
+    0x0211, 0x0211, 0x0213, 0x0213, 0x0215, 0x0215, 0x0217, 0x0217,
+    0x0219, 0x0219, 0x021b, 0x021b, 0x021d, 0x021d, 0x021f, 0x021f,
+    0x019e, 0x0221, 0x0223, 0x0223, 0x0225, 0x0225, 0x0227, 0x0227,
+    0x0229, 0x0229, 0x022b, 0x022b, 0x022d, 0x022d, 0x022f, 0x022f,
+    0x0231, 0x0231, 0x0233, 0x0233, 0x0234, 0x0235, 0x0236, 0x0237,
+    0x0238, 0x0239, 0x2c65, 0x023c, 0x023c, 0x019a, 0x2c66, 0x023f,
+    0x0240, 0x0242, 0x0242, 0x0180, 0x0289, 0x028c, 0x0247, 0x0247,
+    0x0249, 0x0249, 0x024b, 0x024b, 0x024d, 0x024d, 0x024f, 0x024f,
+    0x0250, 0x0251, 0x0252, 0x0253, 0x0254, 0x0255, 0x0256, 0x0257,
+    0x0258, 0x0259, 0x025a, 0x025b, 0x025c, 0x025d, 0x025e, 0x025f,
+    0x0260, 0x0261, 0x0262, 0x0263, 0x0264, 0x0265, 0x0266, 0x0267,
+    0x0268, 0x0269, 0x026a, 0x026b, 0x026c, 0x026d, 0x026e, 0x026f,
+    0x0270, 0x0271, 0x0272, 0x0273, 0x0274, 0x0275, 0x0276, 0x0277,
+    0x0278, 0x0279, 0x027a, 0x027b, 0x027c, 0x027d, 0x027e, 0x027f,
+    0x0280, 0x0281, 0x0282, 0x0283, 0x0284, 0x0285, 0x0286, 0x0287,
+    0x0288, 0x0289, 0x028a, 0x028b, 0x028c, 0x028d, 0x028e, 0x028f,
+    0x0290, 0x0291, 0x0292, 0x0293, 0x0294, 0x0295, 0x0296, 0x0297,
+    0x0298, 0x0299, 0x029a, 0x029b, 0x029c, 0x029d, 0x029e, 0x029f,
+    0x02a0, 0x02a1, 0x02a2, 0x02a3, 0x02a4, 0x02a5, 0x02a6, 0x02a7,
+    0x02a8, 0x02a9, 0x02aa, 0x02ab, 0x02ac, 0x02ad, 0x02ae, 0x02af,
+    0x02b0, 0x02b1, 0x02b2, 0x02b3, 0x02b4, 0x02b5, 0x02b6, 0x02b7,
+    0x02b8, 0x02b9, 0x02ba, 0x02bb, 0x02bc, 0x02bd, 0x02be, 0x02bf,
+    0x02c0, 0x02c1, 0x0000, 0x0000, 0x0000, 0x0000, 0x02c6, 0x02c7,
+    0x02c8, 0x02c9, 0x02ca, 0x02cb, 0x02cc, 0x02cd, 0x02ce, 0x02cf,
+    0x02d0, 0x02d1, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x02e0, 0x02e1, 0x02e2, 0x02e3, 0x02e4, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x02ec, 0x0000, 0x02ee, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0300, 0x0301, 0x0302, 0x0303, 0x0304, 0x0305, 0x0306, 0x0307,
+    0x0308, 0x0309, 0x030a, 0x030b, 0x030c, 0x030d, 0x030e, 0x030f,
+    0x0310, 0x0311, 0x0312, 0x0313, 0x0314, 0x0315, 0x0316, 0x0317,
+    0x0318, 0x0319, 0x031a, 0x031b, 0x031c, 0x031d, 0x031e, 0x031f,
+    0x0320, 0x0321, 0x0322, 0x0323, 0x0324, 0x0325, 0x0326, 0x0327,
+    0x0328, 0x0329, 0x032a, 0x032b, 0x032c, 0x032d, 0x032e, 0x032f,
+    0x0330, 0x0331, 0x0332, 0x0333, 0x0334, 0x0335, 0x0336, 0x0337,
+    0x0338, 0x0339, 0x033a, 0x033b, 0x033c, 0x033d, 0x033e, 0x033f,
+    0x0340, 0x0341, 0x0342, 0x0343, 0x0344, 0x03b9, 0x0346, 0x0347,
+    0x0348, 0x0349, 0x034a, 0x034b, 0x034c, 0x034d, 0x034e, 0x034f,
+    0x0350, 0x0351, 0x0352, 0x0353, 0x0354, 0x0355, 0x0356, 0x0357,
+    0x0358, 0x0359, 0x035a, 0x035b, 0x035c, 0x035d, 0x035e, 0x035f,
+    0x0360, 0x0361, 0x0362, 0x0363, 0x0364, 0x0365, 0x0366, 0x0367,
+    0x0368, 0x0369, 0x036a, 0x036b, 0x036c, 0x036d, 0x036e, 0x036f,
+    0x0371, 0x0371, 0x0373, 0x0373, 0x0374, 0x0000, 0x0377, 0x0377,
+    0x0000, 0x0000, 0x037a, 0x037b, 0x037c, 0x037d, 0x0000, 0x03f3,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x03ac, 0x0000,
+    0x03ad, 0x03ae, 0x03af, 0x0000, 0x03cc, 0x0000, 0x03cd, 0x03ce,
+    0x0390, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,
+    0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,
+    0x03c0, 0x03c1, 0x0000, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,
+    0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03ac, 0x03ad, 0x03ae, 0x03af,
+    0x03b0, 0x03b1, 0x03b2, 0x03b3, 0x03b4, 0x03b5, 0x03b6, 0x03b7,
+    0x03b8, 0x03b9, 0x03ba, 0x03bb, 0x03bc, 0x03bd, 0x03be, 0x03bf,
+    0x03c0, 0x03c1, 0x03c3, 0x03c3, 0x03c4, 0x03c5, 0x03c6, 0x03c7,
+    0x03c8, 0x03c9, 0x03ca, 0x03cb, 0x03cc, 0x03cd, 0x03ce, 0x03d7,
+    0x03b2, 0x03b8, 0x03d2, 0x03d3, 0x03d4, 0x03c6, 0x03c0, 0x03d7,
+    0x03d9, 0x03d9, 0x03db, 0x03db, 0x03dd, 0x03dd, 0x03df, 0x03df,
+    0x03e1, 0x03e1, 0x03e3, 0x03e3, 0x03e5, 0x03e5, 0x03e7, 0x03e7,
+    0x03e9, 0x03e9, 0x03eb, 0x03eb, 0x03ed, 0x03ed, 0x03ef, 0x03ef,
+    0x03ba, 0x03c1, 0x03f2, 0x03f3, 0x03b8, 0x03b5, 0x0000, 0x03f8,
+    0x03f8, 0x03f2, 0x03fb, 0x03fb, 0x03fc, 0x037b, 0x037c, 0x037d,
+    0x0450, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+    0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x045d, 0x045e, 0x045f,
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0439, 0x043a, 0x043b, 0x043c, 0x043d, 0x043e, 0x043f,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+    0x0448, 0x0449, 0x044a, 0x044b, 0x044c, 0x044d, 0x044e, 0x044f,
+    0x0450, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+    0x0458, 0x0459, 0x045a, 0x045b, 0x045c, 0x045d, 0x045e, 0x045f,
+    0x0461, 0x0461, 0x0463, 0x0463, 0x0465, 0x0465, 0x0467, 0x0467,
+    0x0469, 0x0469, 0x046b, 0x046b, 0x046d, 0x046d, 0x046f, 0x046f,
+    0x0471, 0x0471, 0x0473, 0x0473, 0x0475, 0x0475, 0x0477, 0x0477,
+    0x0479, 0x0479, 0x047b, 0x047b, 0x047d, 0x047d, 0x047f, 0x047f,
+    0x0481, 0x0481, 0x0000, 0x0483, 0x0484, 0x0485, 0x0486, 0x0487,
+    0x0488, 0x0489, 0x048b, 0x048b, 0x048d, 0x048d, 0x048f, 0x048f,
+    0x0491, 0x0491, 0x0493, 0x0493, 0x0495, 0x0495, 0x0497, 0x0497,
+    0x0499, 0x0499, 0x049b, 0x049b, 0x049d, 0x049d, 0x049f, 0x049f,
+    0x04a1, 0x04a1, 0x04a3, 0x04a3, 0x04a5, 0x04a5, 0x04a7, 0x04a7,
+    0x04a9, 0x04a9, 0x04ab, 0x04ab, 0x04ad, 0x04ad, 0x04af, 0x04af,
+    0x04b1, 0x04b1, 0x04b3, 0x04b3, 0x04b5, 0x04b5, 0x04b7, 0x04b7,
+    0x04b9, 0x04b9, 0x04bb, 0x04bb, 0x04bd, 0x04bd, 0x04bf, 0x04bf,
+    0x04cf, 0x04c2, 0x04c2, 0x04c4, 0x04c4, 0x04c6, 0x04c6, 0x04c8,
+    0x04c8, 0x04ca, 0x04ca, 0x04cc, 0x04cc, 0x04ce, 0x04ce, 0x04cf,
+    0x04d1, 0x04d1, 0x04d3, 0x04d3, 0x04d5, 0x04d5, 0x04d7, 0x04d7,
+    0x04d9, 0x04d9, 0x04db, 0x04db, 0x04dd, 0x04dd, 0x04df, 0x04df,
+    0x04e1, 0x04e1, 0x04e3, 0x04e3, 0x04e5, 0x04e5, 0x04e7, 0x04e7,
+    0x04e9, 0x04e9, 0x04eb, 0x04eb, 0x04ed, 0x04ed, 0x04ef, 0x04ef,
+    0x04f1, 0x04f1, 0x04f3, 0x04f3, 0x04f5, 0x04f5, 0x04f7, 0x04f7,
+    0x04f9, 0x04f9, 0x04fb, 0x04fb, 0x04fd, 0x04fd, 0x04ff, 0x04ff,
+    0x0501, 0x0501, 0x0503, 0x0503, 0x0505, 0x0505, 0x0507, 0x0507,
+    0x0509, 0x0509, 0x050b, 0x050b, 0x050d, 0x050d, 0x050f, 0x050f,
+    0x0511, 0x0511, 0x0513, 0x0513, 0x0515, 0x0515, 0x0517, 0x0517,
+    0x0519, 0x0519, 0x051b, 0x051b, 0x051d, 0x051d, 0x051f, 0x051f,
+    0x0521, 0x0521, 0x0523, 0x0523, 0x0525, 0x0525, 0x0527, 0x0527,
+    0x0529, 0x0529, 0x052b, 0x052b, 0x052d, 0x052d, 0x052f, 0x052f,
+    0x0000, 0x0561, 0x0562, 0x0563, 0x0564, 0x0565, 0x0566, 0x0567,
+    0x0568, 0x0569, 0x056a, 0x056b, 0x056c, 0x056d, 0x056e, 0x056f,
+    0x0570, 0x0571, 0x0572, 0x0573, 0x0574, 0x0575, 0x0576, 0x0577,
+    0x0578, 0x0579, 0x057a, 0x057b, 0x057c, 0x057d, 0x057e, 0x057f,
+    0x0580, 0x0581, 0x0582, 0x0583, 0x0584, 0x0585, 0x0586, 0x0000,
+    0x0000, 0x0559, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0560, 0x0561, 0x0562, 0x0563, 0x0564, 0x0565, 0x0566, 0x0567,
+    0x0568, 0x0569, 0x056a, 0x056b, 0x056c, 0x056d, 0x056e, 0x056f,
+    0x0570, 0x0571, 0x0572, 0x0573, 0x0574, 0x0575, 0x0576, 0x0577,
+    0x0578, 0x0579, 0x057a, 0x057b, 0x057c, 0x057d, 0x057e, 0x057f,
+    0x0580, 0x0581, 0x0582, 0x0583, 0x0584, 0x0585, 0x0586, 0x0587,
+    0x0588, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0591, 0x0592, 0x0593, 0x0594, 0x0595, 0x0596, 0x0597,
+    0x0598, 0x0599, 0x059a, 0x059b, 0x059c, 0x059d, 0x059e, 0x059f,
+    0x05a0, 0x05a1, 0x05a2, 0x05a3, 0x05a4, 0x05a5, 0x05a6, 0x05a7,
+    0x05a8, 0x05a9, 0x05aa, 0x05ab, 0x05ac, 0x05ad, 0x05ae, 0x05af,
+    0x05b0, 0x05b1, 0x05b2, 0x05b3, 0x05b4, 0x05b5, 0x05b6, 0x05b7,
+    0x05b8, 0x05b9, 0x05ba, 0x05bb, 0x05bc, 0x05bd, 0x0000, 0x05bf,
+    0x0000, 0x05c1, 0x05c2, 0x0000, 0x05c4, 0x05c5, 0x0000, 0x05c7,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x05d0, 0x05d1, 0x05d2, 0x05d3, 0x05d4, 0x05d5, 0x05d6, 0x05d7,
+    0x05d8, 0x05d9, 0x05da, 0x05db, 0x05dc, 0x05dd, 0x05de, 0x05df,
+    0x05e0, 0x05e1, 0x05e2, 0x05e3, 0x05e4, 0x05e5, 0x05e6, 0x05e7,
+    0x05e8, 0x05e9, 0x05ea, 0x0000, 0x0000, 0x0000, 0x0000, 0x05ef,
+    0x05f0, 0x05f1, 0x05f2, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0610, 0x0611, 0x0612, 0x0613, 0x0614, 0x0615, 0x0616, 0x0617,
+    0x0618, 0x0619, 0x061a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0620, 0x0621, 0x0622, 0x0623, 0x0624, 0x0625, 0x0626, 0x0627,
+    0x0628, 0x0629, 0x062a, 0x062b, 0x062c, 0x062d, 0x062e, 0x062f,
+    0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x0637,
+    0x0638, 0x0639, 0x063a, 0x063b, 0x063c, 0x063d, 0x063e, 0x063f,
+    0x0640, 0x0641, 0x0642, 0x0643, 0x0644, 0x0645, 0x0646, 0x0647,
+    0x0648, 0x0649, 0x064a, 0x064b, 0x064c, 0x064d, 0x064e, 0x064f,
+    0x0650, 0x0651, 0x0652, 0x0653, 0x0654, 0x0655, 0x0656, 0x0657,
+    0x0658, 0x0659, 0x065a, 0x065b, 0x065c, 0x065d, 0x065e, 0x065f,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x066e, 0x066f,
+    0x0670, 0x0671, 0x0672, 0x0673, 0x0674, 0x0675, 0x0676, 0x0677,
+    0x0678, 0x0679, 0x067a, 0x067b, 0x067c, 0x067d, 0x067e, 0x067f,
+    0x0680, 0x0681, 0x0682, 0x0683, 0x0684, 0x0685, 0x0686, 0x0687,
+    0x0688, 0x0689, 0x068a, 0x068b, 0x068c, 0x068d, 0x068e, 0x068f,
+    0x0690, 0x0691, 0x0692, 0x0693, 0x0694, 0x0695, 0x0696, 0x0697,
+    0x0698, 0x0699, 0x069a, 0x069b, 0x069c, 0x069d, 0x069e, 0x069f,
+    0x06a0, 0x06a1, 0x06a2, 0x06a3, 0x06a4, 0x06a5, 0x06a6, 0x06a7,
+    0x06a8, 0x06a9, 0x06aa, 0x06ab, 0x06ac, 0x06ad, 0x06ae, 0x06af,
+    0x06b0, 0x06b1, 0x06b2, 0x06b3, 0x06b4, 0x06b5, 0x06b6, 0x06b7,
+    0x06b8, 0x06b9, 0x06ba, 0x06bb, 0x06bc, 0x06bd, 0x06be, 0x06bf,
+    0x06c0, 0x06c1, 0x06c2, 0x06c3, 0x06c4, 0x06c5, 0x06c6, 0x06c7,
+    0x06c8, 0x06c9, 0x06ca, 0x06cb, 0x06cc, 0x06cd, 0x06ce, 0x06cf,
+    0x06d0, 0x06d1, 0x06d2, 0x06d3, 0x0000, 0x06d5, 0x06d6, 0x06d7,
+    0x06d8, 0x06d9, 0x06da, 0x06db, 0x06dc, 0x0000, 0x0000, 0x06df,
+    0x06e0, 0x06e1, 0x06e2, 0x06e3, 0x06e4, 0x06e5, 0x06e6, 0x06e7,
+    0x06e8, 0x0000, 0x06ea, 0x06eb, 0x06ec, 0x06ed, 0x06ee, 0x06ef,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x06fa, 0x06fb, 0x06fc, 0x0000, 0x0000, 0x06ff,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0710, 0x0711, 0x0712, 0x0713, 0x0714, 0x0715, 0x0716, 0x0717,
+    0x0718, 0x0719, 0x071a, 0x071b, 0x071c, 0x071d, 0x071e, 0x071f,
+    0x0720, 0x0721, 0x0722, 0x0723, 0x0724, 0x0725, 0x0726, 0x0727,
+    0x0728, 0x0729, 0x072a, 0x072b, 0x072c, 0x072d, 0x072e, 0x072f,
+    0x0730, 0x0731, 0x0732, 0x0733, 0x0734, 0x0735, 0x0736, 0x0737,
+    0x0738, 0x0739, 0x073a, 0x073b, 0x073c, 0x073d, 0x073e, 0x073f,
+    0x0740, 0x0741, 0x0742, 0x0743, 0x0744, 0x0745, 0x0746, 0x0747,
+    0x0748, 0x0749, 0x074a, 0x0000, 0x0000, 0x074d, 0x074e, 0x074f,
+    0x0750, 0x0751, 0x0752, 0x0753, 0x0754, 0x0755, 0x0756, 0x0757,
+    0x0758, 0x0759, 0x075a, 0x075b, 0x075c, 0x075d, 0x075e, 0x075f,
+    0x0760, 0x0761, 0x0762, 0x0763, 0x0764, 0x0765, 0x0766, 0x0767,
+    0x0768, 0x0769, 0x076a, 0x076b, 0x076c, 0x076d, 0x076e, 0x076f,
+    0x0770, 0x0771, 0x0772, 0x0773, 0x0774, 0x0775, 0x0776, 0x0777,
+    0x0778, 0x0779, 0x077a, 0x077b, 0x077c, 0x077d, 0x077e, 0x077f,
+    0x0780, 0x0781, 0x0782, 0x0783, 0x0784, 0x0785, 0x0786, 0x0787,
+    0x0788, 0x0789, 0x078a, 0x078b, 0x078c, 0x078d, 0x078e, 0x078f,
+    0x0790, 0x0791, 0x0792, 0x0793, 0x0794, 0x0795, 0x0796, 0x0797,
+    0x0798, 0x0799, 0x079a, 0x079b, 0x079c, 0x079d, 0x079e, 0x079f,
+    0x07a0, 0x07a1, 0x07a2, 0x07a3, 0x07a4, 0x07a5, 0x07a6, 0x07a7,
+    0x07a8, 0x07a9, 0x07aa, 0x07ab, 0x07ac, 0x07ad, 0x07ae, 0x07af,
+    0x07b0, 0x07b1, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x07ca, 0x07cb, 0x07cc, 0x07cd, 0x07ce, 0x07cf,
+    0x07d0, 0x07d1, 0x07d2, 0x07d3, 0x07d4, 0x07d5, 0x07d6, 0x07d7,
+    0x07d8, 0x07d9, 0x07da, 0x07db, 0x07dc, 0x07dd, 0x07de, 0x07df,
+    0x07e0, 0x07e1, 0x07e2, 0x07e3, 0x07e4, 0x07e5, 0x07e6, 0x07e7,
+    0x07e8, 0x07e9, 0x07ea, 0x07eb, 0x07ec, 0x07ed, 0x07ee, 0x07ef,
+    0x07f0, 0x07f1, 0x07f2, 0x07f3, 0x07f4, 0x07f5, 0x0000, 0x0000,
+    0x0000, 0x0000, 0x07fa, 0x0000, 0x0000, 0x07fd, 0x0000, 0x0000,
+};
+
+/* Ranges of letters and marks from U+0800 up, sorted. */
+static const struct cp_range letters[] = {
+    {0x00800, 0x0082d}, {0x00840, 0x0085b}, {0x00860, 0x0086a}, {0x00870, 0x00887},
+    {0x00889, 0x0088e}, {0x00898, 0x008e1}, {0x008e3, 0x00963}, {0x00971, 0x00983},
+    {0x00985, 0x0098c}, {0x0098f, 0x00990}, {0x00993, 0x009a8}, {0x009aa, 0x009b0},
+    {0x009b2, 0x009b2}, {0x009b6, 0x009b9}, {0x009bc, 0x009c4}, {0x009c7, 0x009c8},
+    {0x009cb, 0x009ce}, {0x009d7, 0x009d7}, {0x009dc, 0x009dd}, {0x009df, 0x009e3},
+    {0x009f0, 0x009f1}, {0x009fc, 0x009fc}, {0x009fe, 0x009fe}, {0x00a01, 0x00a03},
+    {0x00a05, 0x00a0a}, {0x00a0f, 0x00a10}, {0x00a13, 0x00a28}, {0x00a2a, 0x00a30},
+    {0x00a32, 0x00a33}, {0x00a35, 0x00a36}, {0x00a38, 0x00a39}, {0x00a3c, 0x00a3c},
+    {0x00a3e, 0x00a42}, {0x00a47, 0x00a48}, {0x00a4b, 0x00a4d}, {0x00a51, 0x00a51},
+    {0x00a59, 0x00a5c}, {0x00a5e, 0x00a5e}, {0x00a70, 0x00a75}, {0x00a81, 0x00a83},
+    {0x00a85, 0x00a8d}, {0x00a8f, 0x00a91}, {0x00a93, 0x00aa8}, {0x00aaa, 0x00ab0},
+    {0x00ab2, 0x00ab3}, {0x00ab5, 0x00ab9}, {0x00abc, 0x00ac5}, {0x00ac7, 0x00ac9},
+    {0x00acb, 0x00acd}, {0x00ad0, 0x00ad0}, {0x00ae0, 0x00ae3}, {0x00af9, 0x00aff},
+    {0x00b01, 0x00b03}, {0x00b05, 0x00b0c}, {0x00b0f, 0x00b10}, {0x00b13, 0x00b28},
+    {0x00b2a, 0x00b30}, {0x00b32, 0x00b33}, {0x00b35, 0x00b39}, {0x00b3c, 0x00b44},
+    {0x00b47, 0x00b48}, {0x00b4b, 0x00b4d}, {0x00b55, 0x00b57}, {0x00b5c, 0x00b5d},
+    {0x00b5f, 0x00b63}, {0x00b71, 0x00b71}, {0x00b82, 0x00b83}, {0x00b85, 0x00b8a},
+    {0x00b8e, 0x00b90}, {0x00b92, 0x00b95}, {0x00b99, 0x00b9a}, {0x00b9c, 0x00b9c},
+    {0x00b9e, 0x00b9f}, {0x00ba3, 0x00ba4}, {0x00ba8, 0x00baa}, {0x00bae, 0x00bb9},
+    {0x00bbe, 0x00bc2}, {0x00bc6, 0x00bc8}, {0x00bca, 0x00bcd}, {0x00bd0, 0x00bd0},
+    {0x00bd7, 0x00bd7}, {0x00c00, 0x00c0c}, {0x00c0e, 0x00c10}, {0x00c12, 0x00c28},
+    {0x00c2a, 0x00c39}, {0x00c3c, 0x00c44}, {0x00c46, 0x00c48}, {0x00c4a, 0x00c4d},
+    {0x00c55, 0x00c56}, {0x00c58, 0x00c5a}, {0x00c5d, 0x00c5d}, {0x00c60, 0x00c63},
+    {0x00c80, 0x00c83}, {0x00c85, 0x00c8c}, {0x00c8e, 0x00c90}, {0x00c92, 0x00ca8},
+    {0x00caa, 0x00cb3}, {0x00cb5, 0x00cb9}, {0x00cbc, 0x00cc4}, {0x00cc6, 0x00cc8},
+    {0x00cca, 0x00ccd}, {0x00cd5, 0x00cd6}, {0x00cdd, 0x00cde}, {0x00ce0, 0x00ce3},
+    {0x00cf1, 0x00cf2}, {0x00d00, 0x00d0c}, {0x00d0e, 0x00d10}, {0x00d12, 0x00d44},
+    {0x00d46, 0x00d48}, {0x00d4a, 0x00d4e}, {0x00d54, 0x00d57}, {0x00d5f, 0x00d63},
+    {0x00d7a, 0x00d7f}, {0x00d81, 0x00d83}, {0x00d85, 0x00d96}, {0x00d9a, 0x00db1},
+    {0x00db3, 0x00dbb}, {0x00dbd, 0x00dbd}, {0x00dc0, 0x00dc6}, {0x00dca, 0x00dca},
+    {0x00dcf, 0x00dd4}, {0x00dd6, 0x00dd6}, {0x00dd8, 0x00ddf}, {0x00df2, 0x00df3},
+    {0x00e01, 0x00e3a}, {0x00e40, 0x00e4e}, {0x00e81, 0x00e82}, {0x00e84, 0x00e84},
+    {0x00e86, 0x00e8a}, {0x00e8c, 0x00ea3}, {0x00ea5, 0x00ea5}, {0x00ea7, 0x00ebd},
+    {0x00ec0, 0x00ec4}, {0x00ec6, 0x00ec6}, {0x00ec8, 0x00ecd}, {0x00edc, 0x00edf},
+    {0x00f00, 0x00f00}, {0x00f18, 0x00f19}, {0x00f35, 0x00f35}, {0x00f37, 0x00f37},
+    {0x00f39, 0x00f39}, {0x00f3e, 0x00f47}, {0x00f49, 0x00f6c}, {0x00f71, 0x00f84},
+    {0x00f86, 0x00f97}, {0x00f99, 0x00fbc}, {0x00fc6, 0x00fc6}, {0x01000, 0x0103f},
+    {0x01050, 0x0108f}, {0x0109a, 0x0109d}, {0x010a0, 0x010c5}, {0x010c7, 0x010c7},
+    {0x010cd, 0x010cd}, {0x010d0, 0x010fa}, {0x010fc, 0x01248}, {0x0124a, 0x0124d},
+    {0x01250, 0x01256}, {0x01258, 0x01258}, {0x0125a, 0x0125d}, {0x01260, 0x01288},
+    {0x0128a, 0x0128d}, {0x01290, 0x012b0}, {0x012b2, 0x012b5}, {0x012b8, 0x012be},
+    {0x012c0, 0x012c0}, {0x012c2, 0x012c5}, {0x012c8, 0x012d6}, {0x012d8, 0x01310},
+    {0x01312, 0x01315}, {0x01318, 0x0135a}, {0x0135d, 0x0135f}, {0x01380, 0x0138f},
+    {0x013a0, 0x013f5}, {0x013f8, 0x013fd}, {0x01401, 0x0166c}, {0x0166f, 0x0167f},
+    {0x01681, 0x0169a}, {0x016a0, 0x016ea}, {0x016f1, 0x016f8}, {0x01700, 0x01715},
+    {0x0171f, 0x01734}, {0x01740, 0x01753}, {0x01760, 0x0176c}, {0x0176e, 0x01770},
+    {0x01772, 0x01773}, {0x01780, 0x017d3}, {0x017d7, 0x017d7}, {0x017dc, 0x017dd},
+    {0x0180b, 0x0180d}, {0x0180f, 0x0180f}, {0x01820, 0x01878}, {0x01880, 0x018aa},
+    {0x018b0, 0x018f5}, {0x01900, 0x0191e}, {0x01920, 0x0192b}, {0x01930, 0x0193b},
+    {0x01950, 0x0196d}, {0x01970, 0x01974}, {0x01980, 0x019ab}, {0x019b0, 0x019c9},
+    {0x01a00, 0x01a1b}, {0x01a20, 0x01a5e}, {0x01a60, 0x01a7c}, {0x01a7f, 0x01a7f},
+    {0x01aa7, 0x01aa7}, {0x01ab0, 0x01ace}, {0x01b00, 0x01b4c}, {0x01b6b, 0x01b73},
+    {0x01b80, 0x01baf}, {0x01bba, 0x01bf3}, {0x01c00, 0x01c37}, {0x01c4d, 0x01c4f},
+    {0x01c5a, 0x01c7d}, {0x01c80, 0x01c88}, {0x01c90, 0x01cba}, {0x01cbd, 0x01cbf},
+    {0x01cd0, 0x01cd2}, {0x01cd4, 0x01cfa}, {0x01d00, 0x01f15}, {0x01f18, 0x01f1d},
+    {0x01f20, 0x01f45}, {0x01f48, 0x01f4d}, {0x01f50, 0x01f57}, {0x01f59, 0x01f59},
+    {0x01f5b, 0x01f5b}, {0x01f5d, 0x01f5d}, {0x01f5f, 0x01f7d}, {0x01f80, 0x01fb4},
+    {0x01fb6, 0x01fbc}, {0x01fbe, 0x01fbe}, {0x01fc2, 0x01fc4}, {0x01fc6, 0x01fcc},
+    {0x01fd0, 0x01fd3}, {0x01fd6, 0x01fdb}, {0x01fe0, 0x01fec}, {0x01ff2, 0x01ff4},
+    {0x01ff6, 0x01ffc}, {0x02071, 0x02071}, {0x0207f, 0x0207f}, {0x02090, 0x0209c},
+    {0x020d0, 0x020f0}, {0x02102, 0x02102}, {0x02107, 0x02107}, {0x0210a, 0x02113},
+    {0x02115, 0x02115}, {0x02119, 0x0211d}, {0x02124, 0x02124}, {0x02126, 0x02126},
+    {0x02128, 0x02128}, {0x0212a, 0x0212d}, {0x0212f, 0x02139}, {0x0213c, 0x0213f},
+    {0x02145, 0x02149}, {0x0214e, 0x0214e}, {0x02183, 0x02184}, {0x02c00, 0x02ce4},
+    {0x02ceb, 0x02cf3}, {0x02d00, 0x02d25}, {0x02d27, 0x02d27}, {0x02d2d, 0x02d2d},
+    {0x02d30, 0x02d67}, {0x02d6f, 0x02d6f}, {0x02d7f, 0x02d96}, {0x02da0, 0x02da6},
+    {0x02da8, 0x02dae}, {0x02db0, 0x02db6}, {0x02db8, 0x02dbe}, {0x02dc0, 0x02dc6},
+    {0x02dc8, 0x02dce}, {0x02dd0, 0x02dd6}, {0x02dd8, 0x02dde}, {0x02de0, 0x02dff},
+    {0x02e2f, 0x02e2f}, {0x03005, 0x03006}, {0x0302a, 0x0302f}, {0x03031, 0x03035},
+    {0x0303b, 0x0303c}, {0x03041, 0x03096}, {0x03099, 0x0309a}, {0x0309d, 0x0309f},
+    {0x030a1, 0x030fa}, {0x030fc, 0x030ff}, {0x03105, 0x0312f}, {0x03131, 0x0318e},
+    {0x031a0, 0x031bf}, {0x031f0, 0x031ff}, {0x03400, 0x04dbf}, {0x04e00, 0x0a48c},
+    {0x0a4d0, 0x0a4fd}, {0x0a500, 0x0a60c}, {0x0a610, 0x0a61f}, {0x0a62a, 0x0a62b},
+    {0x0a640, 0x0a672}, {0x0a674, 0x0a67d}, {0x0a67f, 0x0a6e5}, {0x0a6f0, 0x0a6f1},
+    {0x0a717, 0x0a71f}, {0x0a722, 0x0a788}, {0x0a78b, 0x0a7ca}, {0x0a7d0, 0x0a7d1},
+    {0x0a7d3, 0x0a7d3}, {0x0a7d5, 0x0a7d9}, {0x0a7f2, 0x0a827}, {0x0a82c, 0x0a82c},
+    {0x0a840, 0x0a873}, {0x0a880, 0x0a8c5}, {0x0a8e0, 0x0a8f7}, {0x0a8fb, 0x0a8fb},
+    {0x0a8fd, 0x0a8ff}, {0x0a90a, 0x0a92d}, {0x0a930, 0x0a953}, {0x0a960, 0x0a97c},
+    {0x0a980, 0x0a9c0}, {0x0a9cf, 0x0a9cf}, {0x0a9e0, 0x0a9ef}, {0x0a9fa, 0x0a9fe},
+    {0x0aa00, 0x0aa36}, {0x0aa40, 0x0aa4d}, {0x0aa60, 0x0aa76}, {0x0aa7a, 0x0aac2},
+    {0x0aadb, 0x0aadd}, {0x0aae0, 0x0aaef}, {0x0aaf2, 0x0aaf6}, {0x0ab01, 0x0ab06},
+    {0x0ab09, 0x0ab0e}, {0x0ab11, 0x0ab16}, {0x0ab20, 0x0ab26}, {0x0ab28, 0x0ab2e},
+    {0x0ab30, 0x0ab5a}, {0x0ab5c, 0x0ab69}, {0x0ab70, 0x0abea}, {0x0abec, 0x0abed},
+    {0x0ac00, 0x0d7a3}, {0x0d7b0, 0x0d7c6}, {0x0d7cb, 0x0d7fb}, {0x0f900, 0x0fa6d},
+    {0x0fa70, 0x0fad9}, {0x0fb00, 0x0fb06}, {0x0fb13, 0x0fb17}, {0x0fb1d, 0x0fb28},
+    {0x0fb2a, 0x0fb36}, {0x0fb38, 0x0fb3c}, {0x0fb3e, 0x0fb3e}, {0x0fb40, 0x0fb41},
+    {0x0fb43, 0x0fb44}, {0x0fb46, 0x0fbb1}, {0x0fbd3, 0x0fd3d}, {0x0fd50, 0x0fd8f},
+    {0x0fd92, 0x0fdc7}, {0x0fdf0, 0x0fdfb}, {0x0fe00, 0x0fe0f}, {0x0fe20, 0x0fe2f},
+    {0x0fe70, 0x0fe74}, {0x0fe76, 0x0fefc}, {0x0ff21, 0x0ff3a}, {0x0ff41, 0x0ff5a},
+    {0x0ff66, 0x0ffbe}, {0x0ffc2, 0x0ffc7}, {0x0ffca, 0x0ffcf}, {0x0ffd2, 0x0ffd7},
+    {0x0ffda, 0x0ffdc}, {0x10000, 0x1000b}, {0x1000d, 0x10026}, {0x10028, 0x1003a},
+    {0x1003c, 0x1003d}, {0x1003f, 0x1004d}, {0x10050, 0x1005d}, {0x10080, 0x100fa},
+    {0x101fd, 0x101fd}, {0x10280, 0x1029c}, {0x102a0, 0x102d0}, {0x102e0, 0x102e0},
+    {0x10300, 0x1031f}, {0x1032d, 0x10340}, {0x10342, 0x10349}, {0x10350, 0x1037a},
+    {0x10380, 0x1039d}, {0x103a0, 0x103c3}, {0x103c8, 0x103cf}, {0x10400, 0x1049d},
+    {0x104b0, 0x104d3}, {0x104d8, 0x104fb}, {0x10500, 0x10527}, {0x10530, 0x10563},
+    {0x10570, 0x1057a}, {0x1057c, 0x1058a}, {0x1058c, 0x10592}, {0x10594, 0x10595},
+    {0x10597, 0x105a1}, {0x105a3, 0x105b1}, {0x105b3, 0x105b9}, {0x105bb, 0x105bc},
+    {0x10600, 0x10736}, {0x10740, 0x10755}, {0x10760, 0x10767}, {0x10780, 0x10785},
+    {0x10787, 0x107b0}, {0x107b2, 0x107ba}, {0x10800, 0x10805}, {0x10808, 0x10808},
+    {0x1080a, 0x10835}, {0x10837, 0x10838}, {0x1083c, 0x1083c}, {0x1083f, 0x10855},
+    {0x10860, 0x10876}, {0x10880, 0x1089e}, {0x108e0, 0x108f2}, {0x108f4, 0x108f5},
+    {0x10900, 0x10915}, {0x10920, 0x10939}, {0x10980, 0x109b7}, {0x109be, 0x109bf},
+    {0x10a00, 0x10a03}, {0x10a05, 0x10a06}, {0x10a0c, 0x10a13}, {0x10a15, 0x10a17},
+    {0x10a19, 0x10a35}, {0x10a38, 0x10a3a}, {0x10a3f, 0x10a3f}, {0x10a60, 0x10a7c},
+    {0x10a80, 0x10a9c}, {0x10ac0, 0x10ac7}, {0x10ac9, 0x10ae6}, {0x10b00, 0x10b35},
+    {0x10b40, 0x10b55}, {0x10b60, 0x10b72}, {0x10b80, 0x10b91}, {0x10c00, 0x10c48},
+    {0x10c80, 0x10cb2}, {0x10cc0, 0x10cf2}, {0x10d00, 0x10d27}, {0x10e80, 0x10ea9},
+    {0x10eab, 0x10eac}, {0x10eb0, 0x10eb1}, {0x10f00, 0x10f1c}, {0x10f27, 0x10f27},
+    {0x10f30, 0x10f50}, {0x10f70, 0x10f85}, {0x10fb0, 0x10fc4}, {0x10fe0, 0x10ff6},
+    {0x11000, 0x11046}, {0x11070, 0x11075}, {0x1107f, 0x110ba}, {0x110c2, 0x110c2},
+    {0x110d0, 0x110e8}, {0x11100, 0x11134}, {0x11144, 0x11147}, {0x11150, 0x11173},
+    {0x11176, 0x11176}, {0x11180, 0x111c4}, {0x111c9, 0x111cc}, {0x111ce, 0x111cf},
+    {0x111da, 0x111da}, {0x111dc, 0x111dc}, {0x11200, 0x11211}, {0x11213, 0x11237},
+    {0x1123e, 0x1123e}, {0x11280, 0x11286}, {0x11288, 0x11288}, {0x1128a, 0x1128d},
+    {0x1128f, 0x1129d}, {0x1129f, 0x112a8}, {0x112b0, 0x112ea}, {0x11300, 0x11303},
+    {0x11305, 0x1130c}, {0x1130f, 0x11310}, {0x11313, 0x11328}, {0x1132a, 0x11330},
+    {0x11332, 0x11333}, {0x11335, 0x11339}, {0x1133b, 0x11344}, {0x11347, 0x11348},
+    {0x1134b, 0x1134d}, {0x11350, 0x11350}, {0x11357, 0x11357}, {0x1135d, 0x11363},
+    {0x11366, 0x1136c}, {0x11370, 0x11374}, {0x11400, 0x1144a}, {0x1145e, 0x11461},
+    {0x11480, 0x114c5}, {0x114c7, 0x114c7}, {0x11580, 0x115b5}, {0x115b8, 0x115c0},
+    {0x115d8, 0x115dd}, {0x11600, 0x11640}, {0x11644, 0x11644}, {0x11680, 0x116b8},
+    {0x11700, 0x1171a}, {0x1171d, 0x1172b}, {0x11740, 0x11746}, {0x11800, 0x1183a},
+    {0x118a0, 0x118df}, {0x118ff, 0x11906}, {0x11909, 0x11909}, {0x1190c, 0x11913},
+    {0x11915, 0x11916}, {0x11918, 0x11935}, {0x11937, 0x11938}, {0x1193b, 0x11943},
+    {0x119a0, 0x119a7}, {0x119aa, 0x119d7}, {0x119da, 0x119e1}, {0x119e3, 0x119e4},
+    {0x11a00, 0x11a3e}, {0x11a47, 0x11a47}, {0x11a50, 0x11a99}, {0x11a9d, 0x11a9d},
+    {0x11ab0, 0x11af8}, {0x11c00, 0x11c08}, {0x11c0a, 0x11c36}, {0x11c38, 0x11c40},
+    {0x11c72, 0x11c8f}, {0x11c92, 0x11ca7}, {0x11ca9, 0x11cb6}, {0x11d00, 0x11d06},
+    {0x11d08, 0x11d09}, {0x11d0b, 0x11d36}, {0x11d3a, 0x11d3a}, {0x11d3c, 0x11d3d},
+    {0x11d3f, 0x11d47}, {0x11d60, 0x11d65}, {0x11d67, 0x11d68}, {0x11d6a, 0x11d8e},
+    {0x11d90, 0x11d91}, {0x11d93, 0x11d98}, {0x11ee0, 0x11ef6}, {0x11fb0, 0x11fb0},
+    {0x12000, 0x12399}, {0x12480, 0x12543}, {0x12f90, 0x12ff0}, {0x13000, 0x1342e},
+    {0x14400, 0x14646}, {0x16800, 0x16a38}, {0x16a40, 0x16a5e}, {0x16a70, 0x16abe},
+    {0x16ad0, 0x16aed}, {0x16af0, 0x16af4}, {0x16b00, 0x16b36}, {0x16b40, 0x16b43},
+    {0x16b63, 0x16b77}, {0x16b7d, 0x16b8f}, {0x16e40, 0x16e7f}, {0x16f00, 0x16f4a},
+    {0x16f4f, 0x16f87}, {0x16f8f, 0x16f9f}, {0x16fe0, 0x16fe1}, {0x16fe3, 0x16fe4},
+    {0x16ff0, 0x16ff1}, {0x17000, 0x187f7}, {0x18800, 0x18cd5}, {0x18d00, 0x18d08},
+    {0x1aff0, 0x1aff3}, {0x1aff5, 0x1affb}, {0x1affd, 0x1affe}, {0x1b000, 0x1b122},
+    {0x1b150, 0x1b152}, {0x1b164, 0x1b167}, {0x1b170, 0x1b2fb}, {0x1bc00, 0x1bc6a},
+    {0x1bc70, 0x1bc7c}, {0x1bc80, 0x1bc88}, {0x1bc90, 0x1bc99}, {0x1bc9d, 0x1bc9e},
+    {0x1cf00, 0x1cf2d}, {0x1cf30, 0x1cf46}, {0x1d165, 0x1d169}, {0x1d16d, 0x1d172},
+    {0x1d17b, 0x1d182}, {0x1d185, 0x1d18b}, {0x1d1aa, 0x1d1ad}, {0x1d242, 0x1d244},
+    {0x1d400, 0x1d454}, {0x1d456, 0x1d49c}, {0x1d49e, 0x1d49f}, {0x1d4a2, 0x1d4a2},
+    {0x1d4a5, 0x1d4a6}, {0x1d4a9, 0x1d4ac}, {0x1d4ae, 0x1d4b9}, {0x1d4bb, 0x1d4bb},
+    {0x1d4bd, 0x1d4c3}, {0x1d4c5, 0x1d505}, {0x1d507, 0x1d50a}, {0x1d50d, 0x1d514},
+    {0x1d516, 0x1d51c}, {0x1d51e, 0x1d539}, {0x1d53b, 0x1d53e}, {0x1d540, 0x1d544},
+    {0x1d546, 0x1d546}, {0x1d54a, 0x1d550}, {0x1d552, 0x1d6a5}, {0x1d6a8, 0x1d6c0},
+    {0x1d6c2, 0x1d6da}, {0x1d6dc, 0x1d6fa}, {0x1d6fc, 0x1d714}, {0x1d716, 0x1d734},
+    {0x1d736, 0x1d74e}, {0x1d750, 0x1d76e}, {0x1d770, 0x1d788}, {0x1d78a, 0x1d7a8},
+    {0x1d7aa, 0x1d7c2}, {0x1d7c4, 0x1d7cb}, {0x1da00, 0x1da36}, {0x1da3b, 0x1da6c},
+    {0x1da75, 0x1da75}, {0x1da84, 0x1da84}, {0x1da9b, 0x1da9f}, {0x1daa1, 0x1daaf},
+    {0x1df00, 0x1df1e}, {0x1e000, 0x1e006}, {0x1e008, 0x1e018}, {0x1e01b, 0x1e021},
+    {0x1e023, 0x1e024}, {0x1e026, 0x1e02a}, {0x1e100, 0x1e12c}, {0x1e130, 0x1e13d},
+    {0x1e14e, 0x1e14e}, {0x1e290, 0x1e2ae}, {0x1e2c0, 0x1e2ef}, {0x1e7e0, 0x1e7e6},
+    {0x1e7e8, 0x1e7eb}, {0x1e7ed, 0x1e7ee}, {0x1e7f0, 0x1e7fe}, {0x1e800, 0x1e8c4},
+    {0x1e8d0, 0x1e8d6}, {0x1e900, 0x1e94b}, {0x1ee00, 0x1ee03}, {0x1ee05, 0x1ee1f},
+    {0x1ee21, 0x1ee22}, {0x1ee24, 0x1ee24}, {0x1ee27, 0x1ee27}, {0x1ee29, 0x1ee32},
+    {0x1ee34, 0x1ee37}, {0x1ee39, 0x1ee39}, {0x1ee3b, 0x1ee3b}, {0x1ee42, 0x1ee42},
+    {0x1ee47, 0x1ee47}, {0x1ee49, 0x1ee49}, {0x1ee4b, 0x1ee4b}, {0x1ee4d, 0x1ee4f},
+    {0x1ee51, 0x1ee52}, {0x1ee54, 0x1ee54}, {0x1ee57, 0x1ee57}, {0x1ee59, 0x1ee59},
+    {0x1ee5b, 0x1ee5b}, {0x1ee5d, 0x1ee5d}, {0x1ee5f, 0x1ee5f}, {0x1ee61, 0x1ee62},
+    {0x1ee64, 0x1ee64}, {0x1ee67, 0x1ee6a}, {0x1ee6c, 0x1ee72}, {0x1ee74, 0x1ee77},
+    {0x1ee79, 0x1ee7c}, {0x1ee7e, 0x1ee7e}, {0x1ee80, 0x1ee89}, {0x1ee8b, 0x1ee9b},
+    {0x1eea1, 0x1eea3}, {0x1eea5, 0x1eea9}, {0x1eeab, 0x1eebb}, {0x20000, 0x2a6df},
+    {0x2a700, 0x2b738}, {0x2b740, 0x2b81d}, {0x2b820, 0x2cea1}, {0x2ceb0, 0x2ebe0},
+    {0x2f800, 0x2fa1d}, {0x30000, 0x3134a}, {0xe0100, 0xe01ef},
+};
+
+/*
+ * Case folding from U+0800 up, sorted: every stride-th code point of the
+ * range folds to itself plus delta.
+ */
+static const struct fold_range folds[] = {
+    {{0x010a0, 0x010c5}, 7264, 1},
+    {{0x010c7, 0x010c7}, 7264, 1},
+    {{0x010cd, 0x010cd}, 7264, 1},
+    {{0x013f8, 0x013fd}, -8, 1},
+    {{0x01c80, 0x01c80}, -6222, 1},
+    {{0x01c81, 0x01c81}, -6221, 1},
+    {{0x01c82, 0x01c82}, -6212, 1},
+    {{0x01c83, 0x01c84}, -6210, 1},
+    {{0x01c85, 0x01c85}, -6211, 1},
+    {{0x01c86, 0x01c86}, -6204, 1},
+    {{0x01c87, 0x01c87}, -6180, 1},
+    {{0x01c88, 0x01c88}, 35267, 1},
+    {{0x01c90, 0x01cba}, -3008, 1},
+    {{0x01cbd, 0x01cbf}, -3008, 1},
+    {{0x01e00, 0x01e94}, 1, 2},
+    {{0x01e9b, 0x01e9b}, -58, 1},
+    {{0x01e9e, 0x01e9e}, -7615, 1},
+    {{0x01ea0, 0x01efe}, 1, 2},
+    {{0x01f08, 0x01f0f}, -8, 1},
+    {{0x01f18, 0x01f1d}, -8, 1},
+    {{0x01f28, 0x01f2f}, -8, 1},
+    {{0x01f38, 0x01f3f}, -8, 1},
+    {{0x01f48, 0x01f4d}, -8, 1},
+    {{0x01f59, 0x01f5f}, -8, 2},
+    {{0x01f68, 0x01f6f}, -8, 1},
+    {{0x01f88, 0x01f8f}, -8, 1},
+    {{0x01f98, 0x01f9f}, -8, 1},
+    {{0x01fa8, 0x01faf}, -8, 1},
+    {{0x01fb8, 0x01fb9}, -8, 1},
+    {{0x01fba, 0x01fbb}, -74, 1},
+    {{0x01fbc, 0x01fbc}, -9, 1},
+    {{0x01fbe, 0x01fbe}, -7173, 1},
+    {{0x01fc8, 0x01fcb}, -86, 1},
+    {{0x01fcc, 0x01fcc}, -9, 1},
+    {{0x01fd8, 0x01fd9}, -8, 1},
+    {{0x01fda, 0x01fdb}, -100, 1},
+    {{0x01fe8, 0x01fe9}, -8, 1},
+    {{0x01fea, 0x01feb}, -112, 1},
+    {{0x01fec, 0x01fec}, -7, 1},
+    {{0x01ff8, 0x01ff9}, -128, 1},
+    {{0x01ffa, 0x01ffb}, -126, 1},
+    {{0x01ffc, 0x01ffc}, -9, 1},
+    {{0x02126, 0x02126}, -7517, 1},
+    {{0x0212a, 0x0212a}, -8383, 1},
+    {{0x0212b, 0x0212b}, -8262, 1},
+    {{0x02132, 0x02132}, 28, 1},
+    {{0x02183, 0x02183}, 1, 1},
+    {{0x02c00, 0x02c2f}, 48, 1},
+    {{0x02c60, 0x02c60}, 1, 1},
+    {{0x02c62, 0x02c62}, -10743, 1},
+    {{0x02c63, 0x02c63}, -3814, 1},
+    {{0x02c64, 0x02c64}, -10727, 1},
+    {{0x02c67, 0x02c6b}, 1, 2},
+    {{0x02c6d, 0x02c6d}, -10780, 1},
+    {{0x02c6e, 0x02c6e}, -10749, 1},
+    {{0x02c6f, 0x02c6f}, -10783, 1},
+    {{0x02c70, 0x02c70}, -10782, 1},
+    {{0x02c72, 0x02c72}, 1, 1},
+    {{0x02c75, 0x02c75}, 1, 1},
+    {{0x02c7e, 0x02c7f}, -10815, 1},
+    {{0x02c80, 0x02ce2}, 1, 2},
+    {{0x02ceb, 0x02ced}, 1, 2},
+    {{0x02cf2, 0x02cf2}, 1, 1},
+    {{0x0a640, 0x0a66c}, 1, 2},
+    {{0x0a680, 0x0a69a}, 1, 2},
+    {{0x0a722, 0x0a72e}, 1, 2},
+    {{0x0a732, 0x0a76e}, 1, 2},
+    {{0x0a779, 0x0a77b}, 1, 2},
+    {{0x0a77d, 0x0a77d}, -35332, 1},
+    {{0x0a77e, 0x0a786}, 1, 2},
+    {{0x0a78b, 0x0a78b}, 1, 1},
+    {{0x0a78d, 0x0a78d}, -42280, 1},
+    {{0x0a790, 0x0a792}, 1, 2},
+    {{0x0a796, 0x0a7a8}, 1, 2},
+    {{0x0a7aa, 0x0a7aa}, -42308, 1},
+    {{0x0a7ab, 0x0a7ab}, -42319, 1},
+    {{0x0a7ac, 0x0a7ac}, -42315, 1},
+    {{0x0a7ad, 0x0a7ad}, -42305, 1},
+    {{0x0a7ae, 0x0a7ae}, -42308, 1},
+    {{0x0a7b0, 0x0a7b0}, -42258, 1},
+    {{0x0a7b1, 0x0a7b1}, -42282, 1},
+    {{0x0a7b2, 0x0a7b2}, -42261, 1},
+    {{0x0a7b3, 0x0a7b3}, 928, 1},
+    {{0x0a7b4, 0x0a7c2}, 1, 2},
+    {{0x0a7c4, 0x0a7c4}, -48, 1},
+    {{0x0a7c5, 0x0a7c5}, -42307, 1},
+    {{0x0a7c6, 0x0a7c6}, -35384, 1},
+    {{0x0a7c7, 0x0a7c9}, 1, 2},
+    {{0x0a7d0, 0x0a7d0}, 1, 1},
+    {{0x0a7d6, 0x0a7d8}, 1, 2},
+    {{0x0a7f5, 0x0a7f5}, 1, 1},
+    {{0x0ab70, 0x0abbf}, -38864, 1},
+    {{0x0ff21, 0x0ff3a}, 32, 1},
+    {{0x10400, 0x10427}, 40, 1},
+    {{0x104b0, 0x104d3}, 40, 1},
+    {{0x10570, 0x1057a}, 39, 1},
+    {{0x1057c, 0x1058a}, 39, 1},
+    {{0x1058c, 0x10592}, 39, 1},
+    {{0x10594, 0x10595}, 39, 1},
+    {{0x10c80, 0x10cb2}, 64, 1},
+    {{0x118a0, 0x118bf}, 32, 1},
+    {{0x16e40, 0x16e5f}, 32, 1},
+    {{0x1e900, 0x1e921}, 34, 1},
+};
+
+#define NELEMS(a) (sizeof (a) / sizeof (a)[0])
+
+uint32_t utf8_decode(const unsigned char *p, size_t n, size_t *len) {
+    uint32_t cp;
+    size_t need;
+    uint32_t min;
+
+    *len = 1;
+    if (p[0] < 0x80) {
+        return p[0];
+    } else if (p[0] < 0xc2) {
+        return UTF8_INVALID; /* A continuation byte, or overlong. */
+    } else if (p[0] < 0xe0) {
+        cp = p[0] & 0x1f;
+        need = 2;
+        min = 0x80;
+    } else if (p[0] < 0xf0) {
+        cp = p[0] & 0x0f;
+        need = 3;
+        min = 0x800;
+    } else if (p[0] < 0xf5) {
+        cp = p[0] & 0x07;
+        need = 4;
+        min = 0x10000;
+    } else {
+        return UTF8_INVALID;
+    }
+    if (n < need) {
+        return UTF8_INVALID;
+    }
+    for (size_t i = 1; i < need; i++) {
+        if ((p[i] & 0xc0) != 0x80) {
+            return UTF8_INVALID;
+        }
+        cp = (cp << 6) | (p[i] & 0x3f);
+    }
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+        return UTF8_INVALID;
+    }
+    *len = need;
+    return cp;
+}
+
+/* Returns the range of table holding cp, or NULL. */
+static const void *find_range(const void *table, size_t n, size_t size,
+                              uint32_t cp) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct cp_range *r =
+            (const struct cp_range *) ((const char *) table + mid * size);
+        if (cp < r->lo) {
+            hi = mid;
+        } else if (cp > r->hi) {
+            lo = mid + 1;
+        } else {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+uint32_t utf8_fold(uint32_t cp) {
+    if (cp < 0x80) {
+        return (unsigned char) ((cp | 0x20) - 'a') < 26 ? cp | 0x20 : 0;
+    }
+    if (cp < 0x800) {
+        return fold2[cp - 0x80];
+    }
+    if (cp > 0x10ffff ||
+        !find_range(letters, NELEMS(letters), sizeof *letters, cp)) {
+        return 0;
+    }
+    const struct fold_range *f =
+        find_range(folds, NELEMS(folds), sizeof *folds, cp);
+    if (f != NULL && (cp - f->range.lo) % f->stride == 0) {
+        return cp + f->delta;
+    }
+    return cp;
+}
+
+size_t utf8_encode(char *dst, uint32_t cp) {
+    if (cp < 0x80) {
+        dst[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        dst[0] = 0xc0 | (cp >> 6);
+        dst[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    }
+    if (cp < 0x10000) {
+        dst[0] = 0xe0 | (cp >> 12);
+        dst[1] = 0x80 | ((cp >> 6) & 0x3f);
+        dst[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    dst[0] = 0xf0 | (cp >> 18);
+    dst[1] = 0x80 | ((cp >> 12) & 0x3f);
+    dst[2] = 0x80 | ((cp >> 6) & 0x3f);
+    dst[3] = 0x80 | (cp & 0x3f);
+    return 4;
+}
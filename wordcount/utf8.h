@@ -0,0 +1,36 @@
+/*
+ * The utf8 interface decodes UTF-8 and classifies code points for the --utf8
+ * tokenizer. A word character is a letter or a combining mark (Unicode
+ * general categories L and M), and words are compared after simple case
+ * folding, so "Straße", "STRASSE" and "strasse" stay distinct but "ΠΡΆΓΜΑ"
+ * and "πράγμα" are one word. The tables come from the Unicode Character
+ * Database, version 14.0.
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* What utf8_decode returns for a malformed sequence. */
+#define UTF8_INVALID UINT32_MAX
+
+/*
+ * Decodes the character at p, of which n > 0 bytes are available, and stores
+ * its length in *len. Returns UTF8_INVALID with *len set to 1 if the bytes
+ * are not well-formed UTF-8: truncated, overlong, a surrogate or above
+ * U+10FFFF.
+ */
+uint32_t utf8_decode(const unsigned char *p, size_t n, size_t *len);
+
+/*
+ * Returns the case folded form of cp if cp is a word character, or 0 if it is
+ * not (UTF8_INVALID included).
+ */
+uint32_t utf8_fold(uint32_t cp);
+
+/* Writes cp in UTF-8 to dst, which has room for 4 bytes. Returns its length. */
+size_t utf8_encode(char *dst, uint32_t cp);
+
+#endif /* UTF8_H */
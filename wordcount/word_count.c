@@ -22,16 +22,23 @@
  */
 
 #include "word_count.h"
+#include "word_io.h"
 
 void init_words(word_count_list_t *wclist) {
     /* Initialize word count.  */
-    *wclist = NULL;
+    wclist->head = NULL;
+    arena_init(&wclist->arena);
+}
+
+void free_words(word_count_list_t *wclist) {
+    arena_free(&wclist->arena);
+    wclist->head = NULL;
 }
 
 size_t len_words(word_count_list_t *wclist) {
     size_t len = 0;
     word_count_t *cur;
-    for (cur = *wclist; cur != NULL; cur = cur->next) {
+    for (cur = wclist->head; cur != NULL; cur = cur->next) {
         len++;
     }
     return len;
@@ -39,67 +46,93 @@ size_t len_words(word_count_list_t *wclist) {
 
 word_count_t *find_word(word_count_list_t *wclist, char *word) {
     /* Return count for word, if it exists. */
-    word_count_t *wc = *wclist;
+    word_count_t *wc = wclist->head;
     while ((wc != NULL) && (strcmp(word, wc->word) != 0)) {
         wc = wc->next;
     }
     return wc;
 }
 
-word_count_t *add_word(word_count_list_t *wclist, char *word) {
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
     /*
-     * If word is present in word_counts list, increment the count.
-     * Otherwise, insert at head of list with count 1.
+     * If word is present in word_counts list, add to the count.
+     * Otherwise, insert a copy at head of list with the given count. The
+     * entry and its string share one arena allocation.
      */
     word_count_t *wc = find_word(wclist, word);
     if (wc != NULL) {
-        wc->count++;
-    } else if ((wc = malloc(sizeof(word_count_t))) != NULL) {
-        wc->word = word;
-        wc->count = 1;
-        wc->next = *wclist;
-        *wclist = wc;
-    } else {
+        wc->count += count;
+        return wc;
+    }
+    size_t len = strlen(word) + 1;
+    if ((wc = arena_alloc(&wclist->arena, sizeof(word_count_t) + len)) ==
+        NULL) {
         perror("malloc");
+        return NULL;
     }
+    wc->word = memcpy(wc + 1, word, len);
+    wc->count = count;
+    wc->next = wclist->head;
+    wclist->head = wc;
     return wc;
 }
 
+word_count_t *add_word(word_count_list_t *wclist, char *word) {
+    return add_word_with_count(wclist, word, 1);
+}
+
 void fprint_words(word_count_list_t *wclist, FILE *outfile) {
+    write_words_text(wclist, outfile);
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *, void *), void *aux) {
     word_count_t *wc;
-    for (wc = *wclist; wc != NULL; wc = wc->next) {
-        fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+    for (wc = wclist->head; wc != NULL; wc = wc->next) {
+        fn(wc, aux);
     }
 }
 
-void wordcount_insert_ordered(word_count_list_t *wclist, word_count_t *elem,
-                              bool less(const word_count_t *,
-                                        const word_count_t *)) {
-    word_count_t *prev = *wclist;
-    if (prev == NULL || less(elem, prev)) {
-        elem->next = prev;
-        *wclist = elem;
-    } else {
-        word_count_t *cur = prev->next;
-        while (cur != NULL && less(cur, elem)) {
-            prev = cur;
-            cur = prev->next;
+/* Merge two sorted lists into one, taking from a first on ties. */
+static word_count_t *merge_sorted(word_count_t *a, word_count_t *b,
+                                  bool less(const word_count_t *,
+                                            const word_count_t *)) {
+    word_count_t *head = NULL;
+    word_count_t **tail = &head;
+    while (a != NULL && b != NULL) {
+        if (less(b, a)) {
+            *tail = b;
+            b = b->next;
+        } else {
+            *tail = a;
+            a = a->next;
         }
-        prev->next = elem;
-        elem->next = cur;
+        tail = &(*tail)->next;
     }
+    *tail = (a != NULL) ? a : b;
+    return head;
+}
+
+/* Merge sort the first n entries of a list, which must have exactly n. */
+static word_count_t *sort_list(word_count_t *head, size_t n,
+                               bool less(const word_count_t *,
+                                         const word_count_t *)) {
+    if (n < 2) {
+        return head;
+    }
+    word_count_t *mid = head;
+    size_t i;
+    for (i = 1; i < n / 2; i++) {
+        mid = mid->next;
+    }
+    word_count_t *second = mid->next;
+    mid->next = NULL;
+    return merge_sorted(sort_list(head, n / 2, less),
+                        sort_list(second, n - n / 2, less), less);
 }
 
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *)) {
-    word_count_t *head = *wclist;
-    word_count_list_t sorted;
-    init_words(&sorted);
-    while (head != NULL) {
-        word_count_t *to_insert = head;
-        head = head->next;
-        to_insert->next = NULL;
-        wordcount_insert_ordered(&sorted, to_insert, less);
-    }
-    *wclist = sorted;
+    wclist->head = sort_list(wclist->head, len_words(wclist), less);
 }
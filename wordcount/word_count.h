@@ -31,28 +31,67 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
+
 /*
  * Representation of a word count object and word count list object.
  * PINTOS_LIST and/or PTHREADS are #define'd prior to #include to select the
- * representations.
+ * representations. In every representation the entries and their strings are
+ * allocated from an arena owned by the list and released by free_words.
  */
 
 #ifdef PINTOS_LIST
 #include "list.h"
 typedef struct word_count {
     char *word;
-    int count;
+    int count; /* Under PTHREADS, only changed with __atomic builtins. */
     struct list_elem elem;
+#ifdef PTHREADS
+    unsigned int hash;        /* Cached hash of word. */
+    struct word_count *hnext; /* Next entry in the same hash bucket. */
+#endif /* PTHREADS */
 } word_count_t;
 
 #ifdef PTHREADS
 #include <pthread.h>
-typedef struct word_count_list {
-    struct list lst;
+
+/*
+ * Number of independently locked hash shards in a word count list. Must be a
+ * power of two.
+ */
+#define WC_NUM_SHARDS 64
+
+struct retired_buckets;
+
+/*
+ * One lock-striped shard of a word count list: a chained hash table of the
+ * words whose hash selects this shard, plus the list of entries added to it
+ * since the last wordcount_sort. Aligned so that neighbouring shard locks do
+ * not share a cache line.
+ *
+ * The lock is only taken to insert a word. Lookups walk the chains without
+ * it, so bucket arrays replaced by a resize are kept on the retired list
+ * until free_words, in case a reader is still on one.
+ */
+struct word_count_shard {
     pthread_mutex_t lock;
+    word_count_t **buckets;
+    size_t num_buckets;
+    size_t num_words;
+    struct list lst;
+    struct arena arena;
+    struct retired_buckets *retired;
+} __attribute__((aligned(64)));
+
+typedef struct word_count_list {
+    struct word_count_shard shards[WC_NUM_SHARDS];
+    struct list lst; /* Entries gathered and ordered by wordcount_sort. */
 } word_count_list_t;
 #else /* PTHREADS */
-typedef struct list word_count_list_t;
+typedef struct word_count_list {
+    struct list lst;
+    struct arena arena;
+} word_count_list_t;
 #endif /* PTHREADS */
 
 #else /* PINTOS_LIST */
@@ -63,12 +102,22 @@ typedef struct word_count {
     struct word_count *next;
 } word_count_t;
 
-typedef word_count_t *word_count_list_t;
+typedef struct word_count_list {
+    word_count_t *head;
+    struct arena arena;
+} word_count_list_t;
 #endif /* PINTOS_LIST */
 
 /* Initialize a word count list. */
 void init_words(word_count_list_t *wclist);
 
+/*
+ * Release all entries of a word count list, and the memory behind any
+ * word_count_t pointers obtained from it, in one go. The list must be
+ * initialized again before reuse.
+ */
+void free_words(word_count_list_t *wclist);
+
 /* Get length of a word count list. */
 size_t len_words(word_count_list_t *wclist);
 
@@ -77,13 +126,14 @@ word_count_t *find_word(word_count_list_t *wclist, char *word);
 
 /*
  * Insert word with count=1, if not already present; increment count if
- * present. Takes ownership of word.
+ * present. The list stores its own copy of word, made only on insertion, so
+ * the caller keeps ownership of word and may reuse its buffer.
  */
 word_count_t *add_word(word_count_list_t *wclist, char *word);
 
 /*
  * Insert word with count, if not already present; increment count if present.
- * Takes ownership of word.
+ * Copies word like add_word.
  */
 word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
                                   int count);
@@ -91,8 +141,23 @@ word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
 /* Print word counts to a file. */
 void fprint_words(word_count_list_t *wclist, FILE *outfile);
 
+/*
+ * Call fn on every entry of a word count list, in the order fprint_words
+ * would print them. fn must not add words to the list.
+ */
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *, void *), void *aux);
+
 /* Sort a word count list using the provided comparator function. */
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *));
 
+#ifdef PTHREADS
+/*
+ * Move every entry of src into dst, adding counts of words present in both.
+ * Leaves src empty.
+ */
+void merge_words(word_count_list_t *dst, word_count_list_t *src);
+#endif /* PTHREADS */
+
 #endif /* WORD_COUNT_H */
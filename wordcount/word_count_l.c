@@ -1,5 +1,6 @@
 /*
- * Implementation of the word_count interface using Pintos lists.
+ * Implementation of the word_count interface using Pintos lists. Entries and
+ * their strings are packed into the list's arena.
  */
 
 #ifndef PINTOS_LIST
@@ -11,19 +12,28 @@
 #include <string.h>
 #include "list.h"
 #include "word_count.h"
+#include "word_io.h"
 
-/* Initialize the intrusive list. */
+/* Initialize the intrusive list and its arena. */
 void init_words(word_count_list_t *wclist)
 {
-    list_init(wclist);
+    list_init(&wclist->lst);
+    arena_init(&wclist->arena);
+}
+
+/* Entries never leave the list one by one, so dropping the arena is enough. */
+void free_words(word_count_list_t *wclist)
+{
+    arena_free(&wclist->arena);
+    list_init(&wclist->lst);
 }
 
 /* Number of elements in the list. */
 size_t len_words(word_count_list_t *wclist)
 {
     size_t n = 0;
-    for (struct list_elem *it = list_begin(wclist);
-         it != list_end(wclist);
+    for (struct list_elem *it = list_begin(&wclist->lst);
+         it != list_end(&wclist->lst);
          it = list_next(it))
     {
         n++;
@@ -34,8 +44,8 @@ size_t len_words(word_count_list_t *wclist)
 /* Find an existing word node; NULL if not present. */
 word_count_t *find_word(word_count_list_t *wclist, char *word)
 {
-    for (struct list_elem *it = list_begin(wclist);
-         it != list_end(wclist);
+    for (struct list_elem *it = list_begin(&wclist->lst);
+         it != list_end(&wclist->lst);
          it = list_next(it))
     {
         word_count_t *e = list_entry(it, word_count_t, elem);
@@ -54,17 +64,14 @@ word_count_t *add_word_with_count(word_count_list_t *wclist, char *word, int cou
         e->count += count;
         return e;
     }
-    e = malloc(sizeof *e);
+    /* One allocation holds the entry followed by its string. */
+    size_t len = strlen(word) + 1;
+    e = arena_alloc(&wclist->arena, sizeof *e + len);
     if (!e)
         return NULL;
-    e->word = strdup(word);
-    if (!e->word)
-    {
-        free(e);
-        return NULL;
-    }
+    e->word = memcpy(e + 1, word, len);
     e->count = count;
-    list_push_back(wclist, &e->elem);
+    list_push_back(&wclist->lst, &e->elem);
     return e;
 }
 
@@ -73,16 +80,23 @@ word_count_t *add_word(word_count_list_t *wclist, char *word)
     return add_word_with_count(wclist, word, 1);
 }
 
-/* Print counts in the format expected by merge_counts: "%8d\t%ms". */
+/*
+ * Print counts as "%8d\t%s" lines via write_words_text, which batches them
+ * in a word_writer instead of one fprintf per entry.
+ */
 void fprint_words(word_count_list_t *wclist, FILE *outfile)
 {
-    for (struct list_elem *it = list_begin(wclist);
-         it != list_end(wclist);
+    write_words_text(wclist, outfile);
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *, void *), void *aux)
+{
+    for (struct list_elem *it = list_begin(&wclist->lst);
+         it != list_end(&wclist->lst);
          it = list_next(it))
     {
-        word_count_t *e = list_entry(it, word_count_t, elem);
-        /* width 8 so it aligns with provided tools; tab before word */
-        fprintf(outfile, "%8d\t%s\n", e->count, e->word);
+        fn(list_entry(it, word_count_t, elem), aux);
     }
 }
 
@@ -102,5 +116,5 @@ static bool less_list(const struct list_elem *ewc1,
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *))
 {
-    list_sort(wclist, less_list, (void *)less);
+    list_sort(&wclist->lst, less_list, (void *)less);
 }
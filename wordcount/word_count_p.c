@@ -1,5 +1,25 @@
 /*
  * Implementation of the word_count interface using Pintos lists and pthreads.
+ *
+ * Words are spread over WC_NUM_SHARDS hash shards by a string hash. Each shard
+ * is a chained hash table with its own mutex, so threads adding different
+ * words rarely contend and lookups cost O(1) instead of a walk over every
+ * distinct word. Every entry also sits on a Pintos list so that the list
+ * based sort and print keep producing the same output as before.
+ *
+ * Most calls to add_word bump a word that is already there. Those never take
+ * the lock: the chains are published with release stores and walked with
+ * acquire loads, and counts are bumped with an atomic add. Only a word that
+ * is not found takes the shard lock, looks again and inserts. A lookup that
+ * races with a resize may miss a word that is present; it then goes the
+ * locked way too, so the result is the same.
+ *
+ * With THREAD_LOCAL #define'd every table is private to one thread at a time
+ * (see the twords variant of pwords.c) and the locks and atomics compile
+ * away.
+ *
+ * Under --stats, shard locks are taken with a trylock first, so that waits
+ * can be counted and timed.
  */
 
 #ifndef PINTOS_LIST
@@ -14,112 +34,353 @@
 #include <string.h>
 #include <pthread.h>
 #include "list.h"
+#include "stats.h"
 #include "word_count.h"
+#include "word_io.h"
 
-/* Initialize list and mutex. */
+#ifdef THREAD_LOCAL
+#define shard_lock(s) ((void)(s))
+#define shard_unlock(s) ((void)(s))
+#define load_acquire(p) (*(p))
+#define store_release(p, v) (*(p) = (v))
+#define count_add(p, n) (*(p) += (n))
+#else
+#define shard_lock(s) lock_shard(s)
+#define shard_unlock(s) pthread_mutex_unlock(&(s)->lock)
+#define load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define count_add(p, n) __atomic_fetch_add(p, n, __ATOMIC_RELAXED)
+#endif
+
+#ifndef THREAD_LOCAL
+static void lock_shard(struct word_count_shard *s)
+{
+    if (!stats_enabled)
+    {
+        pthread_mutex_lock(&s->lock);
+        return;
+    }
+    stats_record(STATS_LOCKS, 1);
+    if (pthread_mutex_trylock(&s->lock) == 0)
+        return;
+    uint64_t start = stats_clock();
+    pthread_mutex_lock(&s->lock);
+    stats_record(STATS_LOCK_WAITS, 1);
+    stats_record(STATS_LOCK_WAIT_NS, stats_clock() - start);
+}
+#endif
+
+/* A bucket array replaced by shard_grow, freed by free_words. */
+struct retired_buckets {
+    struct retired_buckets *next;
+    word_count_t **buckets;
+};
+
+/* Buckets per shard before the first resize. Must be a power of two. */
+#define INITIAL_BUCKETS 16
+
+/* 32-bit FNV-1a hash of a NUL-terminated string. */
+static unsigned int hash_word(const char *word)
+{
+    unsigned int h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)word; *p; p++)
+    {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* The top bits pick the shard so the low bits stay free for the bucket. */
+static struct word_count_shard *shard_for(word_count_list_t *wclist,
+                                          unsigned int hash)
+{
+    return &wclist->shards[(hash >> 24) & (WC_NUM_SHARDS - 1)];
+}
+
+/*
+ * Look up word in a shard, with or without the shard lock. num_buckets is
+ * read before buckets and shard_grow stores them the other way round, so the
+ * array is never smaller than the mask; an older, smaller mask can only make
+ * the lookup miss.
+ */
+static word_count_t *shard_find(struct word_count_shard *s, const char *word,
+                                unsigned int hash)
+{
+    size_t n = load_acquire(&s->num_buckets);
+    word_count_t **b = load_acquire(&s->buckets);
+    if (n == 0)
+        return NULL;
+    word_count_t *e = load_acquire(&b[hash & (n - 1)]);
+    for (; e != NULL; e = load_acquire(&e->hnext))
+    {
+        if (e->hash == hash && strcmp(e->word, word) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+/*
+ * Double the bucket array of a shard. Caller holds the shard lock. Readers
+ * may still be walking the old chains while the nodes are relinked; they can
+ * be led into a new chain and miss, but every walk still ends.
+ */
+static void shard_grow(struct word_count_shard *s)
+{
+    size_t n = s->num_buckets * 2;
+    word_count_t **b = calloc(n, sizeof *b);
+    struct retired_buckets *r = arena_alloc(&s->arena, sizeof *r);
+    if (!b || !r)
+    {
+        free(b);
+        return; /* Keep the longer chains; lookups stay correct. */
+    }
+    for (size_t i = 0; i < s->num_buckets; i++)
+    {
+        word_count_t *e = s->buckets[i];
+        while (e != NULL)
+        {
+            word_count_t *next = e->hnext;
+            store_release(&e->hnext, b[e->hash & (n - 1)]);
+            b[e->hash & (n - 1)] = e;
+            e = next;
+        }
+    }
+    stats_add(STATS_GROWS, 1);
+    r->buckets = s->buckets;
+    r->next = s->retired;
+    s->retired = r;
+    store_release(&s->buckets, b);
+    store_release(&s->num_buckets, n);
+}
+
+/* Link a node that is not in any table into shard s. Caller holds the lock. */
+static void shard_link(struct word_count_shard *s, word_count_t *e)
+{
+    size_t b = e->hash & (s->num_buckets - 1);
+    e->hnext = s->buckets[b];
+    store_release(&s->buckets[b], e); /* Publishes the node to readers. */
+    list_push_back(&s->lst, &e->elem);
+    if (++s->num_words > s->num_buckets)
+        shard_grow(s);
+}
+
+/* Initialize every shard and the sorted list. */
 void init_words(word_count_list_t *wclist)
 {
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
+    {
+        struct word_count_shard *s = &wclist->shards[i];
+        pthread_mutex_init(&s->lock, NULL);
+        s->buckets = calloc(INITIAL_BUCKETS, sizeof *s->buckets);
+        s->num_buckets = s->buckets ? INITIAL_BUCKETS : 0;
+        s->num_words = 0;
+        list_init(&s->lst);
+        arena_init(&s->arena);
+        s->retired = NULL;
+    }
     list_init(&wclist->lst);
-    pthread_mutex_init(&wclist->lock, NULL);
 }
 
-/* Length with brief lock while traversing. */
+/* Drop every shard's arena and bucket arrays, current and retired. */
+void free_words(word_count_list_t *wclist)
+{
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
+    {
+        struct word_count_shard *s = &wclist->shards[i];
+        for (struct retired_buckets *r = s->retired; r != NULL; r = r->next)
+            free(r->buckets);
+        s->retired = NULL;
+        arena_free(&s->arena);
+        free(s->buckets);
+        s->buckets = NULL;
+        s->num_buckets = 0;
+        s->num_words = 0;
+        list_init(&s->lst);
+        pthread_mutex_destroy(&s->lock);
+    }
+    list_init(&wclist->lst);
+}
+
+/* Sum of the shard sizes, each read under its own lock. */
 size_t len_words(word_count_list_t *wclist)
 {
     size_t n = 0;
-    pthread_mutex_lock(&wclist->lock);
-    for (struct list_elem *it = list_begin(&wclist->lst);
-         it != list_end(&wclist->lst);
-         it = list_next(it))
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
     {
-        n++;
+        struct word_count_shard *s = &wclist->shards[i];
+        shard_lock(s);
+        n += s->num_words;
+        shard_unlock(s);
     }
-    pthread_mutex_unlock(&wclist->lock);
     return n;
 }
 
-/* Find needs the lock to read the shared list safely. */
+/* Lock-free lookup; only a miss is confirmed under the shard lock. */
 word_count_t *find_word(word_count_list_t *wclist, char *word)
 {
-    word_count_t *res = NULL;
-    pthread_mutex_lock(&wclist->lock);
-    for (struct list_elem *it = list_begin(&wclist->lst);
-         it != list_end(&wclist->lst);
-         it = list_next(it))
-    {
-        word_count_t *e = list_entry(it, word_count_t, elem);
-        if (strcmp(e->word, word) == 0)
-        {
-            res = e;
-            break;
-        }
-    }
-    pthread_mutex_unlock(&wclist->lock);
-    return res;
+    unsigned int hash = hash_word(word);
+    struct word_count_shard *s = shard_for(wclist, hash);
+    word_count_t *e = shard_find(s, word, hash);
+    if (e)
+        return e;
+    shard_lock(s);
+    e = shard_find(s, word, hash);
+    shard_unlock(s);
+    return e;
 }
 
-/* Add or increment, holding the lock only while touching the list. */
-word_count_t *add_word(word_count_list_t *wclist, char *word)
+/*
+ * Bump an existing word without the lock. Otherwise take the shard lock,
+ * look again (another thread may have inserted it meanwhile) and insert.
+ */
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count)
 {
-    pthread_mutex_lock(&wclist->lock);
+    unsigned int hash = hash_word(word);
+    struct word_count_shard *s = shard_for(wclist, hash);
+    word_count_t *e = shard_find(s, word, hash);
+    if (e)
+    {
+        count_add(&e->count, count);
+        return e;
+    }
 
-    /* Search */
-    word_count_t *e = NULL;
-    for (struct list_elem *it = list_begin(&wclist->lst);
-         it != list_end(&wclist->lst);
-         it = list_next(it))
+    shard_lock(s);
+    if (s->num_buckets == 0)
     {
-        word_count_t *t = list_entry(it, word_count_t, elem);
-        if (strcmp(t->word, word) == 0)
-        {
-            e = t;
-            break;
-        }
+        shard_unlock(s);
+        return NULL;
     }
 
+    e = shard_find(s, word, hash);
     if (e)
     {
-        e->count++;
-        pthread_mutex_unlock(&wclist->lock);
+        count_add(&e->count, count);
+        shard_unlock(s);
         return e;
     }
 
-    /* Insert */
-    e = malloc(sizeof *e);
+    /* Insert: one allocation from the shard's arena holds entry and word. */
+    size_t len = strlen(word) + 1;
+    e = arena_alloc(&s->arena, sizeof *e + len);
     if (!e)
     {
-        pthread_mutex_unlock(&wclist->lock);
+        shard_unlock(s);
         return NULL;
     }
-    e->word = strdup(word);
-    if (!e->word)
+    e->word = memcpy(e + 1, word, len);
+    e->count = count;
+    e->hash = hash;
+    shard_link(s, e);
+
+    shard_unlock(s);
+    return e;
+}
+
+word_count_t *add_word(word_count_list_t *wclist, char *word)
+{
+    return add_word_with_count(wclist, word, 1);
+}
+
+/*
+ * Shard i of src only holds words that hash to shard i of dst, so merging is
+ * done shard by shard. New words move their nodes across instead of copying,
+ * and dst's shard takes over the memory of src's arena and retired arrays.
+ */
+void merge_words(word_count_list_t *dst, word_count_list_t *src)
+{
+    uint64_t start = stats_begin();
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
     {
-        free(e);
-        pthread_mutex_unlock(&wclist->lock);
-        return NULL;
+        struct word_count_shard *d = &dst->shards[i];
+        struct word_count_shard *s = &src->shards[i];
+        shard_lock(d);
+        if (d->num_buckets == 0)
+        {
+            /* No buckets to link into, as in add_word: leave src alone. */
+            shard_unlock(d);
+            continue;
+        }
+        shard_lock(s);
+        for (size_t b = 0; b < s->num_buckets; b++)
+        {
+            word_count_t *e = s->buckets[b];
+            while (e != NULL)
+            {
+                word_count_t *next = e->hnext;
+                word_count_t *t = shard_find(d, e->word, e->hash);
+                list_remove(&e->elem);
+                if (t)
+                    count_add(&t->count, e->count); /* e goes with its arena. */
+                else
+                    shard_link(d, e);
+                e = next;
+            }
+            s->buckets[b] = NULL;
+        }
+        s->num_words = 0;
+        arena_absorb(&d->arena, &s->arena);
+        if (s->retired)
+        {
+            /* The list nodes live in the arena that was just absorbed. */
+            struct retired_buckets *r = s->retired;
+            while (r->next != NULL)
+                r = r->next;
+            r->next = d->retired;
+            d->retired = s->retired;
+            s->retired = NULL;
+        }
+        shard_unlock(s);
+        shard_unlock(d);
     }
-    e->count = 1;
-    list_push_back(&wclist->lst, &e->elem);
+    stats_end(STATS_MERGE, start);
+}
 
-    pthread_mutex_unlock(&wclist->lock);
-    return e;
+static void lock_all(word_count_list_t *wclist)
+{
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
+        shard_lock(&wclist->shards[i]);
+}
+
+static void unlock_all(word_count_list_t *wclist)
+{
+    for (int i = WC_NUM_SHARDS - 1; i >= 0; i--)
+        shard_unlock(&wclist->shards[i]);
 }
 
-/* Print without allowing concurrent mutation while iterating. */
+/*
+ * Print in wordcount_foreach order, which holds every shard lock: the sorted
+ * entries first, then anything added to the shards since the last sort.
+ */
 void fprint_words(word_count_list_t *wclist, FILE *outfile)
 {
-    pthread_mutex_lock(&wclist->lock);
-    for (struct list_elem *it = list_begin(&wclist->lst);
-         it != list_end(&wclist->lst);
+    write_words_text(wclist, outfile);
+}
+
+static void foreach_list(struct list *lst,
+                         void fn(word_count_t *, void *), void *aux)
+{
+    for (struct list_elem *it = list_begin(lst);
+         it != list_end(lst);
          it = list_next(it))
     {
-        word_count_t *e = list_entry(it, word_count_t, elem);
-        fprintf(outfile, "%8d\t%s\n", e->count, e->word);
+        fn(list_entry(it, word_count_t, elem), aux);
     }
-    pthread_mutex_unlock(&wclist->lock);
 }
 
-/* Sort safely by temporarily taking the lock around list_sort. */
+/* Same order as fprint_words, and likewise under every shard lock. */
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *, void *), void *aux)
+{
+    lock_all(wclist);
+    foreach_list(&wclist->lst, fn, aux);
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
+        foreach_list(&wclist->shards[i].lst, fn, aux);
+    unlock_all(wclist);
+}
+
+/* Adapter from list_elem comparison to the word_count_t comparator. */
 static bool less_list(const struct list_elem *a,
                       const struct list_elem *b, void *aux)
 {
@@ -130,10 +391,20 @@ static bool less_list(const struct list_elem *a,
     return less(wa, wb);
 }
 
+/*
+ * Gather the per-shard lists into one list and sort it, holding every shard
+ * lock so no insert can slip in halfway through.
+ */
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *))
 {
-    pthread_mutex_lock(&wclist->lock);
+    lock_all(wclist);
+    for (int i = 0; i < WC_NUM_SHARDS; i++)
+    {
+        struct list *lst = &wclist->shards[i].lst;
+        if (!list_empty(lst))
+            list_splice(list_end(&wclist->lst), list_begin(lst), list_end(lst));
+    }
     list_sort(&wclist->lst, less_list, (void *)less);
-    pthread_mutex_unlock(&wclist->lock);
+    unlock_all(wclist);
 }
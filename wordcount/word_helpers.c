@@ -23,70 +23,876 @@
  */
 
 #include "word_helpers.h"
+#include "reader.h"
 
 #include <ctype.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 #include "word_count.h"
+#include "sketch.h"
+#include "stats.h"
+#include "utf8.h"
+#include "word_io.h"
 
 /*
- * Reads a word from a stream, skipping initial non-alpha characters, and
- * stores it in a malloc'd buffer. Returns length of the word, or 0 if reached
- * end of file.
+ * Word boundary scanning. A word is a run of ASCII letters (isalpha in the C
+ * locale). With SSE2 or AVX2 available, bytes are classified 16 or 32 at a
+ * time: or-ing in 0x20 folds upper case onto lower case, and a byte is a
+ * letter iff that minus 'a' is below 26 as an unsigned value. Build with
+ * -mavx2 to get the 32-byte variant.
+ *
+ * With --utf8, letters also include the non-ASCII letters and marks of
+ * utf8.h. The scan stays the same, except that it also stops at bytes with
+ * the high bit set, and only those go through the UTF-8 decoder.
  */
-static size_t get_word(char **word, FILE *infile) {
-    int ch;
-    size_t buffer_cap = 16;
-    size_t index = 0;
-    char *buffer;
 
-    /* Skip initial non-alpha characters. */
-    while (!isalpha(ch = fgetc(infile))) {
-        if (ch == EOF) {
-            return 0;
+/* --utf8: tokenize as UTF-8 rather than ASCII. Set by parse_options. */
+static bool utf8_words;
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_WIDTH 32
+
+/* Bit i of the result is set iff p[i] is a letter. */
+static inline uint32_t alpha_mask(const unsigned char *p) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) p);
+    __m256i t = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                                _mm256_set1_epi8('a'));
+    t = _mm256_xor_si256(t, _mm256_set1_epi8((char) 0x80));
+    return (uint32_t) _mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (0x80 + 26)), t));
+}
+
+/* Bit i of the result is set iff p[i] has the high bit set. */
+static inline uint32_t high_mask(const unsigned char *p) {
+    return (uint32_t) _mm256_movemask_epi8(
+        _mm256_loadu_si256((const __m256i *) p));
+}
+
+/* Store the 32 letters at src to dst in lower case. */
+static inline void lower_block(char *dst, const unsigned char *src) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) src);
+    _mm256_storeu_si256((__m256i *) dst,
+                        _mm256_or_si256(v, _mm256_set1_epi8(0x20)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_WIDTH 16
+
+/* Bit i of the result is set iff p[i] is a letter. */
+static inline uint32_t alpha_mask(const unsigned char *p) {
+    __m128i v = _mm_loadu_si128((const __m128i *) p);
+    __m128i t = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+                             _mm_set1_epi8('a'));
+    t = _mm_xor_si128(t, _mm_set1_epi8((char) 0x80));
+    return (uint32_t) _mm_movemask_epi8(
+        _mm_cmplt_epi8(t, _mm_set1_epi8((char) (0x80 + 26))));
+}
+
+/* Bit i of the result is set iff p[i] has the high bit set. */
+static inline uint32_t high_mask(const unsigned char *p) {
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) p));
+}
+
+/* Store the 16 letters at src to dst in lower case. */
+static inline void lower_block(char *dst, const unsigned char *src) {
+    __m128i v = _mm_loadu_si128((const __m128i *) src);
+    _mm_storeu_si128((__m128i *) dst, _mm_or_si128(v, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/* Scalar fallback: true for the bytes isalpha accepts in the C locale. */
+static inline bool is_letter(unsigned char ch) {
+    return (unsigned char) ((ch | 0x20) - 'a') < 26;
+}
+
+/* True for the bytes that may be part of a word. */
+static inline bool is_word_byte(unsigned char ch) {
+    return is_letter(ch) || (utf8_words && ch >= 0x80);
+}
+
+/*
+ * Returns the first letter in [p, end), or end. If high is true, bytes with
+ * the high bit set count as letters.
+ */
+static const unsigned char *skip_non_letters(const unsigned char *p,
+                                             const unsigned char *end,
+                                             bool high) {
+#ifdef SCAN_WIDTH
+    for (; end - p >= SCAN_WIDTH; p += SCAN_WIDTH) {
+        uint32_t m = alpha_mask(p);
+        if (high) {
+            m |= high_mask(p);
+        }
+        if (m != 0) {
+            return p + __builtin_ctz(m);
+        }
+    }
+#endif
+    while (p < end && !is_letter(*p) && !(high && *p >= 0x80)) {
+        p++;
+    }
+    return p;
+}
+
+/* Returns the first non-letter in [p, end), or end. */
+static const unsigned char *skip_letters(const unsigned char *p,
+                                         const unsigned char *end) {
+#ifdef SCAN_WIDTH
+    for (; end - p >= SCAN_WIDTH; p += SCAN_WIDTH) {
+        uint32_t m = ~alpha_mask(p);
+#if SCAN_WIDTH < 32
+        m &= (1u << SCAN_WIDTH) - 1;
+#endif
+        if (m != 0) {
+            return p + __builtin_ctz(m);
         }
     }
+#endif
+    while (p < end && is_letter(*p)) {
+        p++;
+    }
+    return p;
+}
 
-    /* Allocate buffer on heap. */
-    if ((buffer = malloc(buffer_cap * sizeof(char))) == NULL) {
+/* Copy the n letters at src to dst in lower case and NUL-terminate. */
+static void lower_word(char *dst, const unsigned char *src, size_t n) {
+    size_t i = 0;
+#ifdef SCAN_WIDTH
+    for (; i + SCAN_WIDTH <= n; i += SCAN_WIDTH) {
+        lower_block(dst + i, src + i);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = src[i] | 0x20;
+    }
+    dst[n] = '\0';
+}
+
+/* Reusable buffer that words are lowercased into before add_word. */
+struct scratch {
+    char *buf;
+    size_t cap;
+};
+
+/* Make room for n bytes and a NUL in scratch. Returns 0, or -1 on failure. */
+static int reserve(struct scratch *scratch, size_t n) {
+    if (n >= scratch->cap) {
+        size_t cap = scratch->cap ? scratch->cap : 64;
+        char *new_buf;
+        while (n >= cap) {
+            cap *= 2;
+        }
+        if ((new_buf = realloc(scratch->buf, cap)) == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        scratch->buf = new_buf;
+        scratch->cap = cap;
+    }
+    return 0;
+}
+
+/*
+ * count_span for --utf8. A word is a run of ASCII letters and non-ASCII word
+ * characters; the ASCII runs in it are scanned and lowercased as usual and
+ * each non-ASCII character is decoded and case folded on its own. Malformed
+ * bytes end a word like any other non-letter.
+ */
+static ssize_t count_span_utf8(word_count_list_t *wclist,
+                               const unsigned char *p,
+                               const unsigned char *end,
+                               struct scratch *scratch) {
+    ssize_t tokens = 0;
+    while ((p = skip_non_letters(p, end, true)) < end) {
+        size_t len = 0;   /* Bytes of the folded word in scratch. */
+        size_t chars = 0; /* Characters in the word. */
+        for (;;) {
+            const unsigned char *run = p;
+            p = skip_letters(p, end);
+            if (p > run) {
+                if (reserve(scratch, len + (p - run)) != 0) {
+                    return -1;
+                }
+                lower_word(scratch->buf + len, run, p - run);
+                len += p - run;
+                chars += p - run;
+            }
+            if (p == end || *p < 0x80) {
+                break;
+            }
+            size_t n;
+            uint32_t cp = utf8_fold(utf8_decode(p, end - p, &n));
+            p += n;
+            if (cp == 0) {
+                break;
+            }
+            if (reserve(scratch, len + 4) != 0) {
+                return -1;
+            }
+            len += utf8_encode(scratch->buf + len, cp);
+            chars++;
+        }
+        if (chars < 2) {
+            continue;
+        }
+        scratch->buf[len] = '\0';
+        if (add_word(wclist, scratch->buf) == NULL) {
+            return -1;
+        }
+        tokens++;
+    }
+    return tokens;
+}
+
+/* count_span for ASCII words. */
+static ssize_t count_span_ascii(word_count_list_t *wclist,
+                                const unsigned char *p,
+                                const unsigned char *end,
+                                struct scratch *scratch) {
+    ssize_t tokens = 0;
+    while ((p = skip_non_letters(p, end, false)) < end) {
+        const unsigned char *start = p;
+        p = skip_letters(p, end);
+        size_t n = p - start;
+        if (n < 2) {
+            continue;
+        }
+        if (reserve(scratch, n) != 0) {
+            return -1;
+        }
+        lower_word(scratch->buf, start, n);
+        if (add_word(wclist, scratch->buf) == NULL) {
+            return -1;
+        }
+        tokens++;
+    }
+    return tokens;
+}
+
+/*
+ * Counts every word in [p, end), dropping words of length 1. Returns 0 on
+ * success, -1 on allocation failure.
+ */
+static int count_span(word_count_list_t *wclist, const unsigned char *p,
+                      const unsigned char *end, struct scratch *scratch) {
+    uint64_t start = stats_begin();
+    ssize_t tokens = utf8_words ? count_span_utf8(wclist, p, end, scratch)
+                                : count_span_ascii(wclist, p, end, scratch);
+    stats_end(STATS_COUNT, start);
+    if (tokens < 0) {
+        return -1;
+    }
+    stats_add(STATS_TOKENS, tokens);
+    return 0;
+}
+
+/*
+ * Returns the length of the longest prefix of buf[0..n) that does not end in
+ * the middle of a word, i.e. n less any trailing run of letters (and, with
+ * --utf8, non-ASCII bytes).
+ */
+static size_t complete_prefix(const unsigned char *buf, size_t n) {
+    while (n > 0 && is_word_byte(buf[n - 1])) {
+        n--;
+    }
+    return n;
+}
+
+/* Bytes requested from the stream per read in count_words_limit. */
+#define READ_CHUNK 65536
+
+void count_words_limit(word_count_list_t *wclist, FILE *infile, off_t limit) {
+    /*
+     * Read the stream in large chunks and tokenize each one in place. A word
+     * that runs into the end of a chunk is carried over to the front of the
+     * buffer and finished by the next read.
+     */
+    struct scratch scratch = {NULL, 0};
+    size_t cap = READ_CHUNK;
+    size_t keep = 0;
+    unsigned char *buf = malloc(cap);
+    if (buf == NULL) {
         perror("malloc");
-        return 0;
+        return;
     }
 
-    /* Accumulate word's characters into buffer. */
-    do {
-        buffer[index++] = tolower(ch);
+    for (;;) {
+        size_t want = cap - keep;
+        if (limit >= 0 && (off_t) want > limit) {
+            want = limit;
+        }
+        uint64_t start = stats_begin();
+        size_t got = want > 0 ? fread(buf + keep, 1, want, infile) : 0;
+        stats_end(STATS_READ, start);
+        stats_add(STATS_BYTES, got);
+        if (limit >= 0) {
+            limit -= got;
+        }
+        size_t n = keep + got;
+        bool eof = got < want || want == 0;
+
+        size_t done = eof ? n : complete_prefix(buf, n);
+        if (count_span(wclist, buf, buf + done, &scratch) != 0 || eof) {
+            break;
+        }
 
-        /* Expand buffer if full. */
-        if (index == buffer_cap) {
-            char *new_buffer;
-            buffer_cap *= 2;
-            if ((new_buffer = realloc(buffer, buffer_cap)) == NULL) {
+        keep = n - done;
+        memmove(buf, buf + done, keep);
+        if (keep == cap) {
+            unsigned char *new_buf = realloc(buf, cap * 2);
+            if (new_buf == NULL) {
                 perror("realloc");
-                free(buffer);
-                return 0;
+                break;
             }
-            buffer = new_buffer;
+            buf = new_buf;
+            cap *= 2;
         }
-    } while (isalpha(ch = fgetc(infile)));
-    buffer[index] = '\0';
-
-    *word = buffer;
-    return index;
+    }
+    free(scratch.buf);
+    free(buf);
 }
 
 void count_words(word_count_list_t *wclist, FILE *infile) {
-    /* Extract all words in infile and update word counts for them. */
-    char *word;
+    count_words_limit(wclist, infile, -1);
+}
+
+off_t next_word_boundary(FILE *infile, off_t offset) {
+    int ch;
+    if (fseeko(infile, offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    while ((ch = fgetc(infile)) != EOF && is_word_byte(ch)) {
+        offset++;
+    }
+    return offset;
+}
+
+int count_words_buf(word_count_list_t *wclist, const char *buf, size_t len) {
+    struct scratch scratch = {NULL, 0};
+    const unsigned char *p = (const unsigned char *) buf;
+    int rv = count_span(wclist, p, p + len, &scratch);
+    free(scratch.buf);
+    return rv;
+}
+
+ssize_t count_words_chunk(word_count_list_t *wclist, const char *buf,
+                          size_t len, bool at_eof) {
+    const unsigned char *p = (const unsigned char *) buf;
+    size_t done = at_eof ? len : complete_prefix(p, len);
+    struct scratch scratch = {NULL, 0};
+    int rv = count_span(wclist, p, p + done, &scratch);
+    free(scratch.buf);
+    return rv == 0 ? (ssize_t) done : -1;
+}
+
+int count_words_mapped_range(word_count_list_t *wclist, const char *path,
+                             off_t start, off_t len) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    /* mmap needs a regular file; read anything else through stdio. */
+    if (!S_ISREG(st.st_mode)) {
+        FILE *infile = fdopen(fd, "r");
+        if (infile == NULL) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+        count_words_limit(wclist, infile, len);
+        fclose(infile);
+        return 0;
+    }
+
+    if (start > st.st_size) {
+        start = st.st_size;
+    }
+    if (len < 0 || len > st.st_size - start) {
+        len = st.st_size - start;
+    }
+    if (len == 0) {
+        close(fd);
+        return 0;
+    }
+
+    /* The mapping has to start on a page boundary. */
+    off_t page_off = start % sysconf(_SC_PAGESIZE);
+    size_t map_len = len + page_off;
+    char *map = mmap(NULL, map_len, PROT_READ, MAP_PRIVATE, fd, start - page_off);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    madvise(map, map_len, MADV_SEQUENTIAL);
+    stats_add(STATS_BYTES, len); /* Paged in while counting. */
+    int rv = count_words_buf(wclist, map + page_off, len);
+    munmap(map, map_len);
+    return rv;
+}
+
+int count_words_mapped(word_count_list_t *wclist, const char *path) {
+    return count_words_mapped_range(wclist, path, 0, -1);
+}
+
+int count_path(word_count_list_t *wclist, const char *path,
+               const struct wc_options *opts) {
+    if (opts->mapped) {
+        return count_words_mapped(wclist, path);
+    }
+    FILE *infile = fopen(path, "r");
+    if (infile == NULL) {
+        perror(path);
+        return -1;
+    }
+    count_words(wclist, infile);
+    fclose(infile);
+    return 0;
+}
+
+/* Prints a usage line listing the options in optstring. */
+static void usage(const char *prog, const char *optstring) {
+    fprintf(stderr, "usage: %s", prog);
+    for (const char *o = optstring; *o != '\0'; o++) {
+        if (o[1] == ':') {
+            fprintf(stderr, " [-%c %s]", *o, *o == 'x' ? "FILE" : "N");
+            o++;
+        } else {
+            fprintf(stderr, " [-%c]", *o);
+        }
+    }
+    fprintf(stderr, " [--sort=count|alpha] [--utf8] [--stats]"
+                    " [--approx [--epsilon=E] [--delta=D]] [file...]\n");
+}
+
+/* A bounded min-heap of entries ordered by less_count. */
+struct top_heap {
+    word_count_t **items;
     size_t len;
-    while ((len = get_word(&word, infile)) != 0) {
-        if (len == 1) {
-            free(word);
-        } else if (add_word(wclist, word) == NULL) {
-            free(word);
+    size_t cap;
+};
+
+/* Restore the heap property below index i. */
+static void heap_sift_down(struct top_heap *h, size_t i) {
+    for (;;) {
+        size_t min = i;
+        size_t l = 2 * i + 1;
+        size_t r = l + 1;
+        if (l < h->len && less_count(h->items[l], h->items[min])) {
+            min = l;
+        }
+        if (r < h->len && less_count(h->items[r], h->items[min])) {
+            min = r;
+        }
+        if (min == i) {
             return;
         }
+        word_count_t *tmp = h->items[i];
+        h->items[i] = h->items[min];
+        h->items[min] = tmp;
+        i = min;
+    }
+}
+
+/* Offer an entry; it is kept if it beats the smallest one held. */
+static void heap_offer(word_count_t *wc, void *aux) {
+    struct top_heap *h = aux;
+    if (h->len < h->cap) {
+        size_t i = h->len++;
+        while (i > 0 && less_count(wc, h->items[(i - 1) / 2])) {
+            h->items[i] = h->items[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        h->items[i] = wc;
+    } else if (less_count(h->items[0], wc)) {
+        h->items[0] = wc;
+        heap_sift_down(h, 0);
+    }
+}
+
+/* Fill h with the k entries of wclist that sort last. Returns 0 or -1. */
+static int select_top(word_count_list_t *wclist, size_t k, struct top_heap *h) {
+    h->len = 0;
+    h->cap = k;
+    if ((h->items = malloc(k * sizeof *h->items)) == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    wordcount_foreach(wclist, heap_offer, h);
+    return 0;
+}
+
+void fprint_top_words(word_count_list_t *wclist, size_t k, FILE *outfile) {
+    struct top_heap h;
+    struct word_writer *w;
+    uint64_t start = stats_begin();
+    if (k == 0 || select_top(wclist, k, &h) != 0) {
+        return;
+    }
+    stats_end(STATS_SORT, start);
+    if ((w = word_writer_open(outfile)) == NULL) {
+        free(h.items);
+        return;
+    }
+    start = stats_begin();
+
+    /* Popping the min-heap yields the survivors in ascending order. */
+    while (h.len > 0) {
+        word_count_t *wc = h.items[0];
+        h.items[0] = h.items[--h.len];
+        heap_sift_down(&h, 0);
+        word_writer_put_text(w, wc->count, wc->word);
+    }
+    word_writer_close(w);
+    stats_end(STATS_OUTPUT, start);
+    free(h.items);
+}
+
+/* An entry of the array sorted by radix_sort. */
+struct word_entry {
+    const char *word;
+    int count;
+};
+
+/* Ranges of the array still to be sorted from byte depth on. */
+struct radix_range {
+    size_t lo;
+    size_t hi;
+    size_t depth;
+};
+
+/* Below this many entries a range is finished by insertion sort. */
+#define RADIX_CUTOFF 32
+
+/* Sort a[lo, hi) by strcmp of the words from byte depth on. */
+static void insertion_sort(struct word_entry *a, size_t lo, size_t hi,
+                           size_t depth) {
+    for (size_t i = lo + 1; i < hi; i++) {
+        struct word_entry e = a[i];
+        size_t j = i;
+        while (j > lo && strcmp(a[j - 1].word + depth, e.word + depth) > 0) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = e;
+    }
+}
+
+/*
+ * Sort n entries into strcmp order of their words with an MSD radix sort:
+ * distribute a range into 256 buckets by the byte at the current depth, then
+ * sort each bucket by the next byte. Words that end at this depth (bucket 0)
+ * are equal and need no further work. Small ranges go to insertion sort. An
+ * explicit stack of ranges keeps long shared prefixes from recursing deeply.
+ * Returns 0, or -1 if out of memory.
+ */
+static int radix_sort(struct word_entry *a, size_t n) {
+    struct word_entry *tmp = malloc(n * sizeof *tmp);
+    size_t stack_cap = 256;
+    struct radix_range *stack = malloc(stack_cap * sizeof *stack);
+    size_t top = 0;
+    if ((n > 0 && tmp == NULL) || stack == NULL) {
+        free(tmp);
+        free(stack);
+        return -1;
+    }
+
+    stack[top++] = (struct radix_range){0, n, 0};
+    while (top > 0) {
+        struct radix_range r = stack[--top];
+        size_t count[256] = {0};
+        size_t start[256];
+
+        if (r.hi - r.lo < RADIX_CUTOFF) {
+            insertion_sort(a, r.lo, r.hi, r.depth);
+            continue;
+        }
+        for (size_t i = r.lo; i < r.hi; i++) {
+            count[(unsigned char) a[i].word[r.depth]]++;
+        }
+        size_t pos = r.lo;
+        for (int b = 0; b < 256; b++) {
+            start[b] = pos;
+            pos += count[b];
+        }
+        for (size_t i = r.lo; i < r.hi; i++) {
+            tmp[start[(unsigned char) a[i].word[r.depth]]++] = a[i];
+        }
+        memcpy(a + r.lo, tmp + r.lo, (r.hi - r.lo) * sizeof *a);
+
+        /* start[b] is now the end of bucket b. */
+        if (top + 255 > stack_cap) {
+            struct radix_range *s = realloc(stack, 2 * stack_cap * sizeof *s);
+            if (s == NULL) {
+                free(tmp);
+                free(stack);
+                return -1;
+            }
+            stack = s;
+            stack_cap *= 2;
+        }
+        for (int b = 1; b < 256; b++) {
+            if (count[b] > 1) {
+                stack[top++] =
+                    (struct radix_range){start[b] - count[b], start[b],
+                                         r.depth + 1};
+            }
+        }
+    }
+    free(tmp);
+    free(stack);
+    return 0;
+}
+
+/* Growable array of entries filled by wordcount_foreach. */
+struct entry_array {
+    struct word_entry *items;
+    size_t len;
+    size_t cap;
+    bool error;
+};
+
+static void collect_entry(word_count_t *wc, void *aux) {
+    struct entry_array *a = aux;
+    if (a->len == a->cap) {
+        size_t cap = a->cap ? 2 * a->cap : 1024;
+        struct word_entry *items = realloc(a->items, cap * sizeof *items);
+        if (items == NULL) {
+            a->error = true;
+            return;
+        }
+        a->items = items;
+        a->cap = cap;
+    }
+    a->items[a->len].word = wc->word;
+    a->items[a->len].count = wc->count;
+    a->len++;
+}
+
+void fprint_words_alpha(word_count_list_t *wclist, size_t k, FILE *outfile) {
+    struct entry_array a = {NULL, 0, 0, false};
+    struct top_heap h;
+    uint64_t start = stats_begin();
+
+    if (k > 0) {
+        if (select_top(wclist, k, &h) != 0) {
+            return;
+        }
+        for (size_t i = 0; i < h.len; i++) {
+            collect_entry(h.items[i], &a);
+        }
+        free(h.items);
+    } else {
+        wordcount_foreach(wclist, collect_entry, &a);
+    }
+    if (a.error || radix_sort(a.items, a.len) != 0) {
+        fprintf(stderr, "oom\n");
+        free(a.items);
+        return;
+    }
+    stats_end(STATS_SORT, start);
+    start = stats_begin();
+    struct word_writer *w = word_writer_open(outfile);
+    for (size_t i = 0; w != NULL && i < a.len; i++) {
+        word_writer_put_text(w, a.items[i].count, a.items[i].word);
+    }
+    if (w != NULL) {
+        word_writer_close(w);
+    }
+    stats_end(STATS_OUTPUT, start);
+    free(a.items);
+}
+
+void output_words(word_count_list_t *wclist, const struct wc_options *opts,
+                  FILE *outfile) {
+    if (opts->sort_alpha) {
+        fprint_words_alpha(wclist, opts->top_k, outfile);
+    } else if (opts->top_k > 0) {
+        fprint_top_words(wclist, opts->top_k, outfile);
+    } else {
+        uint64_t start = stats_begin();
+        wordcount_sort(wclist, less_count);
+        stats_end(STATS_SORT, start);
+        start = stats_begin();
+        fprint_words(wclist, outfile);
+        stats_end(STATS_OUTPUT, start);
+    }
+}
+
+/* Long options, accepted by every tool. */
+enum {
+    OPT_SORT = 256,
+    OPT_UTF8,
+    OPT_STATS,
+    OPT_APPROX,
+    OPT_EPSILON,
+    OPT_DELTA
+};
+
+static const struct option long_options[] = {
+    {"sort", required_argument, NULL, OPT_SORT},
+    {"utf8", no_argument, NULL, OPT_UTF8},
+    {"stats", no_argument, NULL, OPT_STATS},
+    {"approx", no_argument, NULL, OPT_APPROX},
+    {"epsilon", required_argument, NULL, OPT_EPSILON},
+    {"delta", required_argument, NULL, OPT_DELTA},
+    {NULL, 0, NULL, 0},
+};
+
+/* Parses a number strictly between 0 and 1, returning 0 if s is not one. */
+static double parse_fraction(const char *s) {
+    char *end;
+    double x = strtod(s, &end);
+    return (end != s && *end == '\0' && x > 0 && x < 1) ? x : 0;
+}
+
+/* Words printed by output_sketch. */
+static size_t sketch_top(const struct wc_options *opts) {
+    return opts->top_k > 0 ? opts->top_k : SKETCH_DEFAULT_TOP;
+}
+
+int init_sketch(struct sketch *sk, const struct wc_options *opts) {
+    size_t capacity = sketch_top(opts) * SKETCH_CANDIDATES_PER_TOP;
+    if (capacity > INT32_MAX / 2) {
+        capacity = INT32_MAX / 2;
+    }
+    return sketch_init(sk, opts->sketch_epsilon, opts->sketch_delta, capacity);
+}
+
+void output_sketch(const struct sketch *sk, const struct wc_options *opts,
+                   FILE *outfile) {
+    uint64_t start = stats_begin();
+    sketch_print(sk, sketch_top(opts), outfile);
+    stats_end(STATS_OUTPUT, start);
+}
+
+/* Parses a positive decimal number, returning 0 if s is not one. */
+static unsigned long long parse_positive(const char *s) {
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+    return (*s >= '0' && *s <= '9' && *end == '\0') ? n : 0;
+}
+
+int parse_options(int argc, char *argv[], const char *optstring,
+                  struct wc_options *opts) {
+    int opt;
+    opts->mapped = false;
+    opts->split = 1;
+    opts->inflight = 0;
+    opts->top_k = 0;
+    opts->interval = 0;
+    opts->snapshot_bytes = 0;
+    opts->delta = false;
+    opts->index = NULL;
+    opts->sort_alpha = false;
+    opts->utf8 = false;
+    opts->approx = false;
+    opts->sketch_epsilon = SKETCH_EPSILON;
+    opts->sketch_delta = SKETCH_DELTA;
+    opts->jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (opts->jobs < 1) {
+        opts->jobs = 1;
+    }
+
+    while ((opt = getopt_long(argc, argv, optstring, long_options, NULL)) !=
+           -1) {
+        unsigned long long n = optarg ? parse_positive(optarg) : 0;
+        switch (opt) {
+        case OPT_SORT:
+            if (strcmp(optarg, "alpha") != 0 && strcmp(optarg, "count") != 0) {
+                n = 0;
+                break;
+            }
+            opts->sort_alpha = strcmp(optarg, "alpha") == 0;
+            continue;
+        case OPT_UTF8:
+            opts->utf8 = true;
+            continue;
+        case OPT_STATS:
+            stats_enable(argv[0]);
+            continue;
+        case OPT_APPROX:
+            opts->approx = true;
+            continue;
+        case OPT_EPSILON:
+        case OPT_DELTA: {
+            double x = parse_fraction(optarg);
+            if (x == 0) {
+                n = 0;
+                break;
+            }
+            *(opt == OPT_EPSILON ? &opts->sketch_epsilon
+                                 : &opts->sketch_delta) = x;
+            continue;
+        }
+        case 'm':
+            opts->mapped = true;
+            continue;
+        case 'd':
+            opts->delta = true;
+            continue;
+        case 'x':
+            opts->index = optarg;
+            continue;
+        case 's':
+            opts->split = n;
+            break;
+        case 'j':
+            opts->jobs = n;
+            break;
+        case 'a':
+            opts->inflight = n;
+            break;
+        case 'k':
+            opts->top_k = n;
+            break;
+        case 'i':
+            opts->interval = n;
+            break;
+        case 'b':
+            opts->snapshot_bytes = n;
+            break;
+        default:
+            n = 0;
+        }
+        if (n == 0 || n > INT_MAX) {
+            usage(argv[0], optstring);
+            return -1;
+        }
+        if (opt == 'a' && n > READER_MAX_DEPTH) {
+            fprintf(stderr, "%s: -a is at most %d\n", argv[0],
+                    READER_MAX_DEPTH);
+            return -1;
+        }
+    }
+    if (opts->inflight > 0 &&
+        (opts->mapped || opts->approx || opts->split > 1 ||
+         opts->interval > 0 || opts->snapshot_bytes > 0)) {
+        fprintf(stderr,
+                "%s: -a does not combine with -m, -s, -i, -b or --approx\n",
+                argv[0]);
+        return -1;
     }
+    utf8_words = opts->utf8;
+    return optind;
 }
 
 bool less_count(const word_count_t *wc1, const word_count_t *wc2) {
@@ -27,15 +27,134 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <sys/types.h>
 
 #include "word_count.h"
 
+/* Command line options shared by the word count tools. */
+struct wc_options {
+    bool mapped; /* -m: read input files with count_words_mapped. */
+    int split;   /* -s N: number of byte ranges per input file. */
+    int jobs;    /* -j N: worker count; defaults to the online CPUs. */
+    int inflight; /* -a N: read through a reader (reader.h), N reads deep. */
+    size_t top_k; /* -k N: print only the N most frequent words; 0 = all. */
+    int interval; /* -i N: streaming, snapshot every N seconds. */
+    size_t snapshot_bytes; /* -b N: streaming, snapshot every N bytes. */
+    bool delta;   /* -d: snapshots show counts since the previous one. */
+    const char *index; /* -x FILE: word index to update; see word_index.h. */
+    bool sort_alpha; /* --sort=alpha: print in word order, not by count. */
+    bool utf8;       /* --utf8: words are UTF-8 letters; see utf8.h. */
+    bool approx;     /* --approx: count in a fixed size sketch; see sketch.h. */
+    double sketch_epsilon; /* --epsilon=E: error as a fraction of the total. */
+    double sketch_delta;   /* --delta=D: chance of exceeding that error. */
+};
+
+/*
+ * Parses the options named in optstring, a getopt(3) string made of the shared
+ * options above, and the long options --sort=count|alpha, --utf8, --stats,
+ * --approx, --epsilon=E and --delta=D into opts. Prints a usage message and
+ * returns -1 on a bad option; otherwise returns the index of the first file
+ * argument. --utf8 switches the tokenizer of every count_words* function to
+ * UTF-8, and --stats turns on the profile of stats.h.
+ */
+int parse_options(int argc, char *argv[], const char *optstring,
+                  struct wc_options *opts);
+
+/*
+ * Counts the words of the file at path the way opts asks for. Returns 0 on
+ * success, -1 (after printing an error) on failure.
+ */
+int count_path(word_count_list_t *wclist, const char *path,
+               const struct wc_options *opts);
+
 /*
  * Reads all words from a stream and updates a word count list with their
  * counts.
  */
 void count_words(word_count_list_t *wclist, FILE *infile);
 
+/*
+ * Like count_words, but stops after reading limit bytes from the stream's
+ * current position. A negative limit means no limit.
+ */
+void count_words_limit(word_count_list_t *wclist, FILE *infile, off_t limit);
+
+/*
+ * Counts the words in the len bytes at buf, with the same rules as
+ * count_words. Words are lowercased into a reusable scratch buffer, so a
+ * string is only copied when add_word sees it for the first time. Returns 0
+ * on success, -1 on allocation failure.
+ */
+int count_words_buf(word_count_list_t *wclist, const char *buf, size_t len);
+
+/*
+ * Counts the words in one chunk of a stream. Unless at_eof, a word running
+ * into the end of the chunk is left uncounted so the caller can carry it over
+ * to the next chunk. Returns the number of bytes consumed, or -1 on
+ * allocation failure.
+ */
+ssize_t count_words_chunk(word_count_list_t *wclist, const char *buf,
+                          size_t len, bool at_eof);
+
+/*
+ * Maps the file at path into memory and counts its words in place with
+ * count_words_buf. Files that cannot be mapped (pipes, terminals) are read
+ * with count_words instead. Returns 0 on success, -1 on error.
+ */
+int count_words_mapped(word_count_list_t *wclist, const char *path);
+
+/*
+ * Like count_words_mapped, but only counts the len bytes starting at offset
+ * start. A negative len means up to the end of the file.
+ */
+int count_words_mapped_range(word_count_list_t *wclist, const char *path,
+                             off_t start, off_t len);
+
+/*
+ * Returns the first offset at or after offset whose byte is not alphabetic
+ * (nor, with --utf8, non-ASCII) or the end of the file, so that splitting a
+ * file there cuts no word in half. Leaves the stream positioned arbitrarily.
+ * Returns -1 on error.
+ */
+off_t next_word_boundary(FILE *infile, off_t offset);
+
+/*
+ * Prints the k entries of wclist that sort last under less_count, in the
+ * order (and format) they would take at the end of the fully sorted output.
+ * Selects them with a bounded min-heap in one pass instead of sorting.
+ */
+void fprint_top_words(word_count_list_t *wclist, size_t k, FILE *outfile);
+
+/*
+ * Prints the entries of wclist in alphabetical order, only the k that
+ * fprint_top_words would print if k is not 0. The entries are copied to an
+ * array and sorted with an MSD radix sort on the bytes of the words, which
+ * is much faster than list_sort with less_word on large vocabularies.
+ */
+void fprint_words_alpha(word_count_list_t *wclist, size_t k, FILE *outfile);
+
+/*
+ * Prints the final result as opts asks for: the top -k entries, or the whole
+ * list sorted with less_count, or with --sort=alpha either in word order.
+ */
+void output_words(word_count_list_t *wclist, const struct wc_options *opts,
+                  FILE *outfile);
+
+struct sketch;
+
+/*
+ * Initializes sk for --approx with the error bounds in opts, keeping enough
+ * candidates for the -k words to be printed. Returns 0 or -1.
+ */
+int init_sketch(struct sketch *sk, const struct wc_options *opts);
+
+/*
+ * Prints the heavy hitters of sk for --approx: the top -k of them, or
+ * SKETCH_DEFAULT_TOP, ordered by estimate like output_words.
+ */
+void output_sketch(const struct sketch *sk, const struct wc_options *opts,
+                   FILE *outfile);
+
 /*
  * Returns true if the first entry has a lower count than the second entry,
  * breaking ties according to alphabetical order.
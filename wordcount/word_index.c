@@ -0,0 +1,363 @@
+/*
+ * Implementation of the word_index interface.
+ */
+
+#include "word_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "word_count.h"
+
+/* What a missing index file opens as. */
+static const struct word_index_header empty_header = {WORD_INDEX_MAGIC};
+
+/*
+ * Point the section pointers of ix into its mapping, checking that the
+ * sections fit the file and every offset stays inside them. Entries are
+ * checked as they are read. Returns 0, or -1 if the index is malformed.
+ */
+static int map_sections(struct word_index *ix) {
+    const struct word_index_header *hdr = ix->map;
+    uint64_t size = sizeof *hdr;
+
+    if (memcmp(hdr->magic, WORD_INDEX_MAGIC, sizeof hdr->magic) != 0 ||
+        hdr->nentries > ix->map_len / sizeof *ix->entries ||
+        hdr->strings_len > ix->map_len) {
+        return -1;
+    }
+    size += (uint64_t) hdr->nfiles * sizeof *ix->files;
+    size += (uint64_t) hdr->nwords * (sizeof *ix->words + sizeof *ix->totals);
+    size += hdr->nentries * sizeof *ix->entries;
+    if (size + hdr->strings_len != ix->map_len) {
+        return -1;
+    }
+
+    const char *p = (const char *) ix->map + sizeof *hdr;
+    ix->hdr = hdr;
+    ix->files = (const struct word_index_file *) p;
+    p += hdr->nfiles * sizeof *ix->files;
+    ix->words = (const uint32_t *) p;
+    p += hdr->nwords * sizeof *ix->words;
+    ix->totals = (const int32_t *) p;
+    p += hdr->nwords * sizeof *ix->totals;
+    ix->entries = (const struct word_index_entry *) p;
+    p += hdr->nentries * sizeof *ix->entries;
+    ix->strings = p;
+
+    /* The last string must be terminated, so every offset reads a string. */
+    if (hdr->strings_len > 0 && ix->strings[hdr->strings_len - 1] != '\0') {
+        return -1;
+    }
+    for (uint32_t i = 0; i < hdr->nwords; i++) {
+        if (ix->words[i] >= hdr->strings_len) {
+            return -1;
+        }
+    }
+    for (uint32_t i = 0; i < hdr->nfiles; i++) {
+        const struct word_index_file *f = &ix->files[i];
+        if (f->path >= hdr->strings_len || f->first > hdr->nentries ||
+            f->nentries > hdr->nentries - f->first) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int word_index_open(struct word_index *ix, const char *path) {
+    struct stat st;
+    memset(ix, 0, sizeof *ix);
+    ix->hdr = &empty_header;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror(path);
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if ((size_t) st.st_size < sizeof *ix->hdr) {
+        fprintf(stderr, "%s: not a word index\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    ix->map = map;
+    ix->map_len = st.st_size;
+    if (map_sections(ix) != 0) {
+        fprintf(stderr, "%s: not a word index\n", path);
+        word_index_close(ix);
+        return -1;
+    }
+    return 0;
+}
+
+void word_index_close(struct word_index *ix) {
+    if (ix->map != NULL) {
+        munmap(ix->map, ix->map_len);
+    }
+    memset(ix, 0, sizeof *ix);
+    ix->hdr = &empty_header;
+}
+
+const struct word_index_file *word_index_lookup(const struct word_index *ix,
+                                                const char *path,
+                                                const struct stat *st) {
+    size_t lo = 0, hi = ix->hdr->nfiles;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct word_index_file *f = &ix->files[mid];
+        int c = strcmp(path, ix->strings + f->path);
+        if (c == 0) {
+            bool same = f->size == st->st_size &&
+                        f->mtime_sec == st->st_mtim.tv_sec &&
+                        f->mtime_nsec == st->st_mtim.tv_nsec;
+            return same ? f : NULL;
+        }
+        if (c < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+int word_index_add_file(const struct word_index *ix,
+                        const struct word_index_file *file,
+                        word_count_list_t *wclist) {
+    const struct word_index_entry *e = ix->entries + file->first;
+    for (uint32_t i = 0; i < file->nentries; i++) {
+        if (e[i].word >= ix->hdr->nwords) {
+            fprintf(stderr, "corrupt word index\n");
+            return -1;
+        }
+        add_word_with_count(wclist, (char *) ix->strings + ix->words[e[i].word],
+                            e[i].count);
+    }
+    return 0;
+}
+
+void word_index_add_totals(const struct word_index *ix,
+                           word_count_list_t *wclist) {
+    for (uint32_t i = 0; i < ix->hdr->nwords; i++) {
+        add_word_with_count(wclist, (char *) ix->strings + ix->words[i],
+                            ix->totals[i]);
+    }
+}
+
+/*
+ * State for writing an index: the words of the new index in sorted order,
+ * and the entries of the segments written so far.
+ */
+struct index_builder {
+    word_count_t **words;
+    size_t nwords;
+    struct word_index_entry *entries;
+    uint64_t len;
+    uint64_t cap;
+    bool error;
+};
+
+static int compare_words(const void *a, const void *b) {
+    const word_count_t *wa = *(word_count_t *const *) a;
+    const word_count_t *wb = *(word_count_t *const *) b;
+    return strcmp(wa->word, wb->word);
+}
+
+static int compare_key(const void *key, const void *elem) {
+    return strcmp(key, (*(word_count_t *const *) elem)->word);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    uint32_t wa = ((const struct word_index_entry *) a)->word;
+    uint32_t wb = ((const struct word_index_entry *) b)->word;
+    return (wa > wb) - (wa < wb);
+}
+
+static int compare_sources(const void *a, const void *b) {
+    const struct word_index_source *sa = *(struct word_index_source *const *) a;
+    const struct word_index_source *sb = *(struct word_index_source *const *) b;
+    return strcmp(sa->path, sb->path);
+}
+
+static void collect_word(word_count_t *wc, void *aux) {
+    struct index_builder *b = aux;
+    if (b->len < b->nwords) {
+        b->words[b->len++] = wc;
+    }
+}
+
+/* Append an entry for word to the current segment. */
+static void push_entry(struct index_builder *b, const char *word, int count) {
+    word_count_t **w = bsearch(word, b->words, b->nwords, sizeof *b->words,
+                               compare_key);
+    if (w == NULL) {
+        b->error = true; /* totals is missing a word of some source. */
+        return;
+    }
+    if (b->len == b->cap) {
+        uint64_t cap = b->cap ? 2 * b->cap : 1024;
+        struct word_index_entry *e = realloc(b->entries, cap * sizeof *e);
+        if (e == NULL) {
+            b->error = true;
+            return;
+        }
+        b->entries = e;
+        b->cap = cap;
+    }
+    b->entries[b->len].word = w - b->words;
+    b->entries[b->len].count = count;
+    b->len++;
+}
+
+static void collect_entry(word_count_t *wc, void *aux) {
+    push_entry(aux, wc->word, wc->count);
+}
+
+/* Append the segment of one source to b, filling in its file record. */
+static void build_segment(struct index_builder *b,
+                          const struct word_index *old,
+                          const struct word_index_source *s,
+                          struct word_index_file *f) {
+    f->size = s->st.st_size;
+    f->mtime_sec = s->st.st_mtim.tv_sec;
+    f->mtime_nsec = s->st.st_mtim.tv_nsec;
+    f->first = b->len;
+    if (s->old != NULL) {
+        /* Old and new words are both sorted, so the order carries over. */
+        const struct word_index_entry *e = old->entries + s->old->first;
+        for (uint32_t i = 0; i < s->old->nentries; i++) {
+            if (e[i].word >= old->hdr->nwords) {
+                b->error = true;
+                break;
+            }
+            push_entry(b, old->strings + old->words[e[i].word], e[i].count);
+        }
+    } else {
+        wordcount_foreach(s->counts, collect_entry, b);
+        qsort(b->entries + f->first, b->len - f->first, sizeof *b->entries,
+              compare_entries);
+    }
+    f->nentries = b->len - f->first;
+}
+
+/* Write the string pool: every word, then every path, NUL-terminated. */
+static void write_strings(FILE *out, const struct index_builder *b,
+                          struct word_index_source **order, int n) {
+    for (size_t i = 0; i < b->nwords; i++) {
+        fwrite(b->words[i]->word, 1, strlen(b->words[i]->word) + 1, out);
+    }
+    for (int i = 0; i < n; i++) {
+        fwrite(order[i]->path, 1, strlen(order[i]->path) + 1, out);
+    }
+}
+
+int word_index_write(const char *path, word_count_list_t *totals,
+                     const struct word_index *old,
+                     struct word_index_source *src, int n, uint32_t flags) {
+    struct index_builder b = {NULL, len_words(totals), NULL, 0, 0, false};
+    struct word_index_header hdr = {WORD_INDEX_MAGIC};
+    struct word_index_file *files = calloc(n, sizeof *files);
+    struct word_index_source **order = calloc(n, sizeof *order);
+    uint32_t *offsets = calloc(b.nwords, sizeof *offsets);
+    int32_t *counts = calloc(b.nwords, sizeof *counts);
+    char *tmp = malloc(strlen(path) + sizeof ".tmp");
+    FILE *out = NULL;
+    int rv = -1;
+
+    b.words = calloc(b.nwords, sizeof *b.words);
+    if ((n > 0 && (!files || !order)) || !tmp ||
+        (b.nwords > 0 && (!offsets || !counts || !b.words))) {
+        fprintf(stderr, "oom\n");
+        goto out;
+    }
+
+    /* The word table: sorted strings, each with its total. */
+    wordcount_foreach(totals, collect_word, &b);
+    qsort(b.words, b.nwords, sizeof *b.words, compare_words);
+    b.len = 0;
+    uint64_t strings_len = 0;
+    for (size_t i = 0; i < b.nwords; i++) {
+        offsets[i] = strings_len;
+        counts[i] = b.words[i]->count;
+        strings_len += strlen(b.words[i]->word) + 1;
+    }
+
+    /* File records and their segments, in path order. */
+    for (int i = 0; i < n; i++) {
+        order[i] = &src[i];
+    }
+    qsort(order, n, sizeof *order, compare_sources);
+    for (int i = 0; i < n; i++) {
+        build_segment(&b, old, order[i], &files[i]);
+        files[i].path = strings_len;
+        strings_len += strlen(order[i]->path) + 1;
+    }
+    if (b.error) {
+        fprintf(stderr, "%s: could not build index\n", path);
+        goto out;
+    }
+    if (strings_len > UINT32_MAX || b.nwords > UINT32_MAX) {
+        fprintf(stderr, "%s: index too large\n", path);
+        goto out;
+    }
+
+    hdr.nwords = b.nwords;
+    hdr.nfiles = n;
+    hdr.nentries = b.len;
+    hdr.strings_len = strings_len;
+    hdr.flags = flags;
+
+    /* Write a temporary file and rename it over the old index. */
+    sprintf(tmp, "%s.tmp", path);
+    if ((out = fopen(tmp, "w")) == NULL) {
+        perror(tmp);
+        goto out;
+    }
+    fwrite(&hdr, sizeof hdr, 1, out);
+    fwrite(files, sizeof *files, n, out);
+    fwrite(offsets, sizeof *offsets, b.nwords, out);
+    fwrite(counts, sizeof *counts, b.nwords, out);
+    fwrite(b.entries, sizeof *b.entries, b.len, out);
+    write_strings(out, &b, order, n);
+    if (fflush(out) != 0 || ferror(out) || fsync(fileno(out)) != 0) {
+        perror(tmp);
+        fclose(out);
+        unlink(tmp);
+        goto out;
+    }
+    fclose(out);
+    if (rename(tmp, path) != 0) {
+        perror(path);
+        unlink(tmp);
+        goto out;
+    }
+    rv = 0;
+
+out:
+    free(b.words);
+    free(b.entries);
+    free(files);
+    free(order);
+    free(offsets);
+    free(counts);
+    free(tmp);
+    return rv;
+}
@@ -0,0 +1,120 @@
+/*
+ * The word_index interface keeps word counts on disk between runs, so that a
+ * recount only has to read the input files that changed since the last one.
+ *
+ * An index file is laid out so that it can be used straight from mmap:
+ *
+ *   struct word_index_header
+ *   struct word_index_file   files[nfiles]     sorted by path
+ *   uint32_t                 words[nwords]     string offsets, sorted by word
+ *   int32_t                  totals[nwords]    count of words[i] over all files
+ *   struct word_index_entry  entries[nentries] per-file segments
+ *   char                     strings[strings_len]
+ *
+ * Each file owns a segment of entries, sorted by word, holding the counts of
+ * that file alone; these let an unchanged file be reused when others change.
+ * Files are recognized by path, size and modification time. The header also
+ * records how words were tokenized, since counts made one way cannot be
+ * reused for the other. All fields use the host's byte order.
+ */
+
+#ifndef WORD_INDEX_H
+#define WORD_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "word_count.h"
+
+#define WORD_INDEX_MAGIC "WCINDEX2"
+
+/* Flags of an index: how its words were tokenized. */
+#define WORD_INDEX_UTF8 1 /* --utf8 */
+
+struct word_index_header {
+    char magic[8];
+    uint32_t nwords;
+    uint32_t nfiles;
+    uint64_t nentries;
+    uint64_t strings_len;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct word_index_file {
+    int64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t first;    /* Index of the segment's first entry. */
+    uint32_t nentries; /* Entries in the segment. */
+    uint32_t path;     /* Offset of the path in strings. */
+};
+
+struct word_index_entry {
+    uint32_t word; /* Index into words. */
+    int32_t count;
+};
+
+/* An index file mapped into memory. */
+struct word_index {
+    void *map;
+    size_t map_len;
+    const struct word_index_header *hdr;
+    const struct word_index_file *files;
+    const uint32_t *words;
+    const int32_t *totals;
+    const struct word_index_entry *entries;
+    const char *strings;
+};
+
+/* One input file of an index being written. */
+struct word_index_source {
+    const char *path;
+    struct stat st;
+    const struct word_index_file *old; /* Reuse this segment of the old index, */
+    word_count_list_t *counts;         /* or else write these counts. */
+};
+
+/*
+ * Maps the index at path. A missing file opens as an empty index. Returns 0
+ * on success, -1 (after printing an error) if the file cannot be read or is
+ * not a valid index.
+ */
+int word_index_open(struct word_index *ix, const char *path);
+
+/* Unmaps the index. */
+void word_index_close(struct word_index *ix);
+
+/*
+ * Returns the segment of the file at path if the index has one recorded with
+ * the size and modification time in st, or NULL if the file is new or has
+ * changed since.
+ */
+const struct word_index_file *word_index_lookup(const struct word_index *ix,
+                                                const char *path,
+                                                const struct stat *st);
+
+/*
+ * Adds the counts of one file's segment to wclist with add_word_with_count.
+ * Returns 0, or -1 if the segment is corrupt.
+ */
+int word_index_add_file(const struct word_index *ix,
+                        const struct word_index_file *file,
+                        word_count_list_t *wclist);
+
+/* Adds the counts over all files of the index to wclist. */
+void word_index_add_totals(const struct word_index *ix,
+                           word_count_list_t *wclist);
+
+/*
+ * Writes a new index of the n files in src to path, replacing any existing
+ * file atomically. totals must hold the sum of the sources' counts; old is
+ * the index any reused segments come from, and flags is recorded in the
+ * header. Returns 0 on success, -1 (after printing an error) on failure.
+ */
+int word_index_write(const char *path, word_count_list_t *totals,
+                     const struct word_index *old,
+                     struct word_index_source *src, int n, uint32_t flags);
+
+#endif /* WORD_INDEX_H */
@@ -0,0 +1,307 @@
+/*
+ * Implementation of the word_io interface.
+ */
+
+#include "word_io.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "word_count.h"
+
+/* Write all of iov to fd, retrying on short writes and EINTR. */
+static int write_all(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t n = writev(fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+void word_writer_init(struct word_writer *w, int fd) {
+    w->fd = fd;
+    w->error = 0;
+    w->len = 0;
+}
+
+int word_writer_flush(struct word_writer *w) {
+    struct iovec iov = {w->buf, w->len};
+    if (w->len > 0 && w->error == 0 && write_all(w->fd, &iov, 1) != 0) {
+        w->error = errno;
+    }
+    w->len = 0;
+    return w->error == 0 ? 0 : -1;
+}
+
+void word_writer_put_frame(struct word_writer *w, int count, const char *word) {
+    struct word_frame hdr = {count, strlen(word)};
+    size_t size = sizeof hdr + hdr.len;
+
+    if (size > sizeof w->buf - w->len) {
+        word_writer_flush(w);
+    }
+    if (size > sizeof w->buf) {
+        /* Too big to buffer; send header and word straight from memory. */
+        struct iovec iov[2] = {{&hdr, sizeof hdr}, {(char *) word, hdr.len}};
+        if (w->error == 0 && write_all(w->fd, iov, 2) != 0) {
+            w->error = errno;
+        }
+        return;
+    }
+    memcpy(w->buf + w->len, &hdr, sizeof hdr);
+    memcpy(w->buf + w->len + sizeof hdr, word, hdr.len);
+    w->len += size;
+}
+
+void word_writer_put_bytes(struct word_writer *w, const void *data,
+                           size_t len) {
+    if (len > sizeof w->buf - w->len) {
+        word_writer_flush(w);
+    }
+    if (len > sizeof w->buf) {
+        struct iovec iov = {(void *) data, len};
+        if (w->error == 0 && write_all(w->fd, &iov, 1) != 0) {
+            w->error = errno;
+        }
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+void word_writer_put_marker(struct word_writer *w, uint32_t file) {
+    struct word_frame hdr = {0, file};
+    if (sizeof hdr > sizeof w->buf - w->len) {
+        word_writer_flush(w);
+    }
+    memcpy(w->buf + w->len, &hdr, sizeof hdr);
+    w->len += sizeof hdr;
+}
+
+/* Longest text line prefix: a sign, ten digits and a tab. */
+#define TEXT_PREFIX_MAX 12
+
+/* Format count as "%8d\t" into dst. Returns the length. */
+static size_t format_count(char *dst, int count) {
+    char digits[TEXT_PREFIX_MAX];
+    unsigned int v = count < 0 ? -(unsigned int) count : (unsigned int) count;
+    size_t n = 0;
+    size_t len = 0;
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    if (count < 0) {
+        digits[n++] = '-';
+    }
+    for (; n + len < 8; len++) {
+        dst[len] = ' ';
+    }
+    while (n > 0) {
+        dst[len++] = digits[--n];
+    }
+    dst[len++] = '\t';
+    return len;
+}
+
+void word_writer_put_text(struct word_writer *w, int count, const char *word) {
+    size_t wlen = strlen(word);
+    size_t size = TEXT_PREFIX_MAX + wlen + 1;
+
+    if (size > sizeof w->buf - w->len) {
+        word_writer_flush(w);
+    }
+    if (size > sizeof w->buf) {
+        /* Too big to buffer; send the word straight from memory. */
+        char prefix[TEXT_PREFIX_MAX];
+        struct iovec iov[3] = {{prefix, format_count(prefix, count)},
+                               {(char *) word, wlen},
+                               {"\n", 1}};
+        if (w->error == 0 && write_all(w->fd, iov, 3) != 0) {
+            w->error = errno;
+        }
+        return;
+    }
+    char *p = w->buf + w->len;
+    p += format_count(p, count);
+    memcpy(p, word, wlen);
+    p[wlen] = '\n';
+    w->len = p + wlen + 1 - w->buf;
+}
+
+struct word_writer *word_writer_open(FILE *outfile) {
+    struct word_writer *w = malloc(sizeof *w);
+    if (w == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    fflush(outfile);
+    word_writer_init(w, fileno(outfile));
+    return w;
+}
+
+int word_writer_close(struct word_writer *w) {
+    int rv = word_writer_flush(w);
+    if (rv != 0) {
+        errno = w->error;
+        perror("write");
+    }
+    free(w);
+    return rv;
+}
+
+static void put_entry(word_count_t *wc, void *aux) {
+    word_writer_put_frame(aux, wc->count, wc->word);
+}
+
+static void put_text(word_count_t *wc, void *aux) {
+    word_writer_put_text(aux, wc->count, wc->word);
+}
+
+int write_words_text(word_count_list_t *wclist, FILE *outfile) {
+    struct word_writer *w = word_writer_open(outfile);
+    if (w == NULL) {
+        return -1;
+    }
+    wordcount_foreach(wclist, put_text, w);
+    return word_writer_close(w);
+}
+
+/* Write wclist to fd, after a marker for file unless file is negative. */
+static int write_frames(word_count_list_t *wclist, int64_t file, int fd) {
+    struct word_writer *w = malloc(sizeof *w);
+    if (w == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    word_writer_init(w, fd);
+    if (file >= 0) {
+        word_writer_put_marker(w, file);
+    }
+    wordcount_foreach(wclist, put_entry, w);
+    int rv = word_writer_flush(w);
+    if (rv != 0) {
+        errno = w->error;
+        perror("write counts");
+    }
+    free(w);
+    return rv;
+}
+
+int write_words_binary(word_count_list_t *wclist, int fd) {
+    return write_frames(wclist, -1, fd);
+}
+
+int write_file_words_binary(word_count_list_t *wclist, uint32_t file, int fd) {
+    return write_frames(wclist, file, fd);
+}
+
+int word_reader_init(struct word_reader *r, int fd) {
+    r->fd = fd;
+    r->len = 0;
+    r->cap = WORD_WRITER_SIZE;
+    r->select = NULL;
+    r->aux = NULL;
+    r->target = NULL;
+    if ((r->buf = malloc(r->cap + 1)) == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    return 0;
+}
+
+void word_reader_destroy(struct word_reader *r) {
+    free(r->buf);
+    r->buf = NULL;
+}
+
+int word_reader_merge(struct word_reader *r, word_count_list_t *wclist) {
+    ssize_t n;
+    while ((n = read(r->fd, r->buf + r->len, r->cap - r->len)) < 0) {
+        if (errno != EINTR) {
+            perror("could not read counts");
+            return -1;
+        }
+    }
+    if (n == 0) {
+        if (r->len != 0) {
+            fprintf(stderr, "read truncated count frame\n");
+            return -1;
+        }
+        return 0;
+    }
+    r->len += n;
+
+    /*
+     * Merge every complete frame. The byte after each word (the next header,
+     * or the spare byte past cap) is borrowed to NUL-terminate it in place.
+     */
+    size_t pos = 0;
+    struct word_frame hdr;
+    while (r->len - pos >= sizeof hdr) {
+        memcpy(&hdr, r->buf + pos, sizeof hdr);
+        if (hdr.count == 0) {
+            if (r->select != NULL) {
+                r->target = r->select(r->aux, hdr.len);
+            }
+            pos += sizeof hdr;
+            continue;
+        }
+        if (r->len - pos - sizeof hdr < hdr.len) {
+            break;
+        }
+        char *word = r->buf + pos + sizeof hdr;
+        char saved = word[hdr.len];
+        word[hdr.len] = '\0';
+        add_word_with_count(r->target ? r->target : wclist, word, hdr.count);
+        word[hdr.len] = saved;
+        pos += sizeof hdr + hdr.len;
+    }
+
+    /* Keep the partial frame; grow if a single frame exceeds the buffer. */
+    memmove(r->buf, r->buf + pos, r->len - pos);
+    r->len -= pos;
+    if (r->len >= sizeof hdr) {
+        memcpy(&hdr, r->buf, sizeof hdr);
+        if (hdr.count != 0 && sizeof hdr + hdr.len > r->cap) {
+            char *new_buf = realloc(r->buf, sizeof hdr + hdr.len + 1);
+            if (new_buf == NULL) {
+                perror("realloc");
+                return -1;
+            }
+            r->buf = new_buf;
+            r->cap = sizeof hdr + hdr.len;
+        }
+    }
+    return 1;
+}
+
+int merge_words_binary(word_count_list_t *wclist, int fd) {
+    struct word_reader r;
+    int rv;
+    if (word_reader_init(&r, fd) != 0) {
+        return -1;
+    }
+    while ((rv = word_reader_merge(&r, wclist)) > 0) {
+    }
+    word_reader_destroy(&r);
+    return rv;
+}
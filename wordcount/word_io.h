@@ -0,0 +1,135 @@
+/*
+ * The word_io interface moves word count lists through file descriptors. A
+ * word_writer batches output in a large buffer and hands it to the kernel in
+ * single writes, both for the final text output of every tool and for the
+ * compact binary framing that fwords uses to ship counts from its children
+ * to the parent.
+ *
+ * In the binary framing each entry is a frame: a struct word_frame header
+ * followed by the len bytes of the word, without a terminating NUL. Frames use
+ * the host's byte order, so both ends must run on the same machine.
+ *
+ * A frame with a count of 0 carries no word: it is a marker saying that the
+ * frames after it are the counts of input file number len. Writers that keep
+ * files apart send one before each file's words.
+ */
+
+#ifndef WORD_IO_H
+#define WORD_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "word_count.h"
+
+/* Bytes buffered by a word_writer before it issues a write. */
+#define WORD_WRITER_SIZE (64 * 1024)
+
+struct word_frame {
+    int32_t count;
+    uint32_t len;
+};
+
+/* Accumulates output for a file descriptor and writes it in large batches. */
+struct word_writer {
+    int fd;
+    int error;  /* errno of the first failed write, or 0. */
+    size_t len; /* Bytes pending in buf. */
+    char buf[WORD_WRITER_SIZE];
+};
+
+/* Initialize a writer for fd. */
+void word_writer_init(struct word_writer *w, int fd);
+
+/* Append one binary frame to the writer. */
+void word_writer_put_frame(struct word_writer *w, int count, const char *word);
+
+/* Append len raw bytes to the writer. */
+void word_writer_put_bytes(struct word_writer *w, const void *data, size_t len);
+
+/* Append a marker frame for input file number file. */
+void word_writer_put_marker(struct word_writer *w, uint32_t file);
+
+/*
+ * Append one entry as a text line, byte for byte what fprintf(3) prints for
+ * "%8d\t%s\n", with the number formatted by hand.
+ */
+void word_writer_put_text(struct word_writer *w, int count, const char *word);
+
+/*
+ * Allocate a writer for the descriptor under outfile, flushing outfile first
+ * so the output stays in order. Returns NULL (after printing an error) if out
+ * of memory.
+ */
+struct word_writer *word_writer_open(FILE *outfile);
+
+/*
+ * Flush and free a writer from word_writer_open. Returns 0, or -1 (after
+ * printing an error) if any write failed.
+ */
+int word_writer_close(struct word_writer *w);
+
+/*
+ * Print every entry of wclist to outfile as text lines, in wordcount_foreach
+ * order, through a word_writer rather than stdio. Returns 0 on success, -1
+ * on error.
+ */
+int write_words_text(word_count_list_t *wclist, FILE *outfile);
+
+/*
+ * Write out everything pending. Returns 0, or -1 if this or any earlier write
+ * failed.
+ */
+int word_writer_flush(struct word_writer *w);
+
+/*
+ * Write every entry of wclist to fd as binary frames. Returns 0 on success,
+ * -1 on a write error.
+ */
+int write_words_binary(word_count_list_t *wclist, int fd);
+
+/*
+ * Like write_words_binary, but precedes the entries with a marker frame for
+ * input file number file.
+ */
+int write_file_words_binary(word_count_list_t *wclist, uint32_t file, int fd);
+
+/* Incremental reader of binary frames from a file descriptor. */
+struct word_reader {
+    int fd;
+    char *buf;  /* Holds a partial frame between reads. */
+    size_t len; /* Bytes pending in buf. */
+    size_t cap; /* Size of buf, less the byte kept for a terminating NUL. */
+    /*
+     * Called with aux on each marker frame, if set; returns the list that
+     * the frames up to the next marker are added to.
+     */
+    word_count_list_t *(*select)(void *aux, uint32_t file);
+    void *aux;
+    word_count_list_t *target; /* Set by the last marker, or NULL. */
+};
+
+/* Initialize a reader for fd. Returns 0, or -1 if out of memory. */
+int word_reader_init(struct word_reader *r, int fd);
+
+/*
+ * Do one read from r's descriptor and add every complete frame to wclist, or
+ * to the list chosen by the last marker frame.
+ * Returns 1 if more data may follow, 0 at a clean end of file, -1 on a read
+ * error or a stream that ends inside a frame. Suitable for use with poll.
+ */
+int word_reader_merge(struct word_reader *r, word_count_list_t *wclist);
+
+/* Release the reader's buffer. Does not close its descriptor. */
+void word_reader_destroy(struct word_reader *r);
+
+/*
+ * Read binary frames from fd until end of file and add each to wclist with
+ * add_word_with_count. Words are terminated in place in the read buffer, so
+ * no memory is allocated per word. Returns 0 on success, -1 on a read error
+ * or a truncated stream.
+ */
+int merge_words_binary(word_count_list_t *wclist, int fd);
+
+#endif /* WORD_IO_H */
@@ -1,5 +1,8 @@
 /*
- * Word count application with a single thread.
+ * Word count application with a single counting thread. With -i N or -b N it
+ * runs in streaming mode and prints a snapshot every N seconds or N bytes of
+ * input, for inputs such as log streams that never end. With --approx it
+ * counts into a fixed size sketch and prints only the heavy hitters.
  *
  * You may NOT modify this file. Any changes you make to this file will not
  * be used when grading your submission.
@@ -23,41 +26,287 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "reader.h"
+#include "sketch.h"
+#include "stats.h"
 #include "word_count.h"
 #include "word_helpers.h"
 
+/* Bytes read from the input per read(2) in streaming mode. */
+#define STREAM_CHUNK 65536
+
+/*
+ * Streaming mode (-i or -b) state, shared by the main thread, which counts
+ * input into the active table, and the snapshot thread. Tables are double
+ * buffered: a snapshot swaps in the spare table under the lock and then
+ * merges and prints the retired one without holding it, so taking a snapshot
+ * never stalls ingestion for longer than a pointer swap.
+ */
+struct stream {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    word_count_list_t tables[2];
+    word_count_list_t *active; /* Table the main thread counts into. */
+    size_t pending;            /* Bytes counted into active. */
+    bool eof;                  /* Input is exhausted. */
+    const struct wc_options *opts;
+};
+
+static void add_to_total(word_count_t *wc, void *total) {
+    add_word_with_count(total, wc->word, wc->count);
+}
+
+/*
+ * Snapshot thread: every opts->interval seconds, or once opts->snapshot_bytes
+ * have been counted, retire the active table and print either it (-d) or the
+ * running total it is merged into. Prints a last snapshot at end of input.
+ */
+static void *snapshot_thread(void *arg) {
+    struct stream *st = arg;
+    const struct wc_options *opts = st->opts;
+    word_count_list_t total;
+    bool done = false;
+    bool first = true;
+    init_words(&total);
+
+    while (!done) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += opts->interval;
+
+        pthread_mutex_lock(&st->lock);
+        while (!st->eof && !(opts->snapshot_bytes > 0 &&
+                             st->pending >= opts->snapshot_bytes)) {
+            if (opts->interval == 0) {
+                pthread_cond_wait(&st->cond, &st->lock);
+            } else if (pthread_cond_timedwait(&st->cond, &st->lock,
+                                              &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        done = st->eof;
+        size_t bytes = st->pending;
+        word_count_list_t *delta = st->active;
+        st->active = &st->tables[delta == &st->tables[0]];
+        st->pending = 0;
+        pthread_mutex_unlock(&st->lock);
+
+        if (bytes > 0 || (done && first)) {
+            if (!first) {
+                putchar('\n');
+            }
+            first = false;
+            if (opts->delta) {
+                output_words(delta, opts, stdout);
+            } else {
+                wordcount_foreach(delta, add_to_total, &total);
+                output_words(&total, opts, stdout);
+            }
+            fflush(stdout);
+        }
+        free_words(delta);
+        init_words(delta);
+    }
+    free_words(&total);
+    return NULL;
+}
+
+/*
+ * Feed a descriptor into the active table, one chunk at a time. Returns 0 on
+ * success, or -1 if a read or an allocation fails.
+ */
+static int stream_fd(struct stream *st, int fd) {
+    size_t cap = STREAM_CHUNK;
+    size_t keep = 0;
+    int rv = 0;
+    char *buf = malloc(cap);
+    if (buf == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    for (;;) {
+        uint64_t start = stats_begin();
+        ssize_t n = read(fd, buf + keep, cap - keep);
+        stats_end(STATS_READ, start);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("read");
+            rv = -1;
+            break;
+        }
+        stats_add(STATS_BYTES, n);
+        size_t len = keep + n;
+
+        pthread_mutex_lock(&st->lock);
+        ssize_t used = count_words_chunk(st->active, buf, len, n == 0);
+        st->pending += n;
+        if (st->opts->snapshot_bytes > 0 &&
+            st->pending >= st->opts->snapshot_bytes) {
+            pthread_cond_signal(&st->cond);
+        }
+        pthread_mutex_unlock(&st->lock);
+        if (used < 0) {
+            rv = -1;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+
+        /* Carry a word cut by the end of the chunk over to the next read. */
+        keep = len - used;
+        memmove(buf, buf + used, keep);
+        if (keep == cap) {
+            char *new_buf = realloc(buf, cap * 2);
+            if (new_buf == NULL) {
+                perror("realloc");
+                rv = -1;
+                break;
+            }
+            buf = new_buf;
+            cap *= 2;
+        }
+    }
+    free(buf);
+    return rv;
+}
+
+/* Count stdin, or the files in paths, in streaming mode. */
+static int stream_words(char *paths[], int npaths,
+                        const struct wc_options *opts) {
+    struct stream st;
+    pthread_t tid;
+    int rv = 0;
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    init_words(&st.tables[0]);
+    init_words(&st.tables[1]);
+    st.active = &st.tables[0];
+    st.pending = 0;
+    st.eof = false;
+    st.opts = opts;
+    if (pthread_create(&tid, NULL, snapshot_thread, &st) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+
+    if (npaths == 0 && stream_fd(&st, STDIN_FILENO) != 0) {
+        rv = 1;
+    }
+    for (int i = 0; i < npaths && rv == 0; i++) {
+        int fd = open(paths[i], O_RDONLY);
+        if (fd < 0) {
+            perror(paths[i]);
+            rv = 1;
+        } else {
+            if (stream_fd(&st, fd) != 0) {
+                rv = 1;
+            }
+            close(fd);
+        }
+    }
+
+    pthread_mutex_lock(&st.lock);
+    st.eof = true;
+    pthread_cond_signal(&st.cond);
+    pthread_mutex_unlock(&st.lock);
+    pthread_join(tid, NULL);
+    free_words(&st.tables[0]);
+    free_words(&st.tables[1]);
+    return rv;
+}
+
+/* Count stdin, or the files in paths, into a sketch and print the top. */
+static int approx_words(char *paths[], int npaths,
+                        const struct wc_options *opts) {
+    struct sketch sk;
+    word_count_list_t scratch;
+    int rv = 0;
+    if (init_sketch(&sk, opts) != 0) {
+        return 1;
+    }
+    init_words(&scratch);
+
+    if (npaths == 0 && sketch_count_path(&sk, &scratch, NULL, 0, -1) != 0) {
+        rv = 1;
+    }
+    for (int i = 0; i < npaths && rv == 0; i++) {
+        if (sketch_count_path(&sk, &scratch, paths[i], 0, -1) != 0) {
+            rv = 1;
+        }
+    }
+    if (rv == 0) {
+        output_sketch(&sk, opts, stdout);
+    }
+    free_words(&scratch);
+    sketch_free(&sk);
+    return rv;
+}
+
 /*
  * main - handle command line and file handles.
  */
 int main(int argc, char *argv[]) {
+    struct wc_options opts;
+    int first_file = parse_options(argc, argv, "a:b:di:k:m", &opts);
+    if (first_file < 0) {
+        return 1;
+    }
+    if (opts.interval > 0 || opts.snapshot_bytes > 0) {
+        if (opts.approx) {
+            fprintf(stderr, "%s: --approx does not stream\n", argv[0]);
+            return 1;
+        }
+        return stream_words(&argv[first_file], argc - first_file, &opts);
+    }
+    if (opts.approx) {
+        return approx_words(&argv[first_file], argc - first_file, &opts);
+    }
+
     /* Create the empty data structure. */
     word_count_list_t word_counts;
     init_words(&word_counts);
 
-    if (argc <= 1) {
+    if (first_file >= argc) {
         count_words(&word_counts, stdin);
+    } else if (opts.inflight > 0) {
+        /* Read ahead in the background while this thread counts. */
+        struct reader *r = reader_open(&argv[first_file], argc - first_file,
+                                       opts.inflight);
+        if (r == NULL) {
+            return 1;
+        }
+        int rv = reader_count(r, &word_counts);
+        reader_close(r);
+        if (rv != 0) {
+            return 1;
+        }
     } else {
         /* Process each file. */
         int i;
-        for (i = 1; i < argc; i++) {
-            FILE *infile = fopen(argv[i], "r");
-            if (infile == NULL) {
-                perror("fopen");
+        for (i = first_file; i < argc; i++) {
+            if (count_path(&word_counts, argv[i], &opts) != 0) {
                 return 1;
             }
-            count_words(&word_counts, infile);
-            fclose(infile);
         }
     }
 
     /* Output final result. */
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
+    output_words(&word_counts, &opts, stdout);
+    free_words(&word_counts);
     return 0;
 }